@@ -7,118 +7,430 @@ This program demonstrates inter-process communication using a pipe.
 It forks a child process that writes a message ("Hello World") to a pipe, 
 which the parent process reads and outputs to either a file, 
 the terminal, or both, based on command-line arguments. 
+With -n the parent forks several children, each with its own pipe, and multiplexes them with epoll, 
+merging their output one complete line at a time.
+The parent moves the data with splice() and tee() so it never passes through a user-space buffer; 
+destinations that cannot be spliced (such as a terminal) fall back to a plain read/write copy.
 */
 
 #include <iostream>
 #include <unistd.h>
-#include <fcntl.h>
+#include <fcntl.h>  // for splice(), tee(), F_SETPIPE_SZ
+#include <cerrno>
+#include <algorithm> // for min()
 #include <cstring>
+#include <cstdlib> // for atoi()
 #include <sys/wait.h>
+#include <sys/epoll.h> // for epoll_create1(), epoll_ctl(), epoll_wait()
+#include <string>
+#include <vector>
 using namespace std;
 
+const int PIPE_CAPACITY = 1 << 20; // Requested pipe size; the kernel may clamp it to /proc/sys/fs/pipe-max-size
+
 // Function to print the usage instructions
 void print_usage() {
-    cout << "Usage: ./3 [-o] [-b]" << endl;
+    cout << "Usage: ./3 [-o] [-b] [-n <children>]" << endl;
     cout << " -o : Redirect output to output.txt only." << endl;
     cout << " -b : Redirect output to output.txt and the terminal." << endl;
+    cout << " -n : Number of child processes writing to the parent (default 1)." << endl;
 }
 
-int main(int argc, char* argv[])
+// Enlarge the pipe so each splice()/tee() call can move more data at once.
+// Returns the resulting pipe size, which is used as the chunk size for the copy loops.
+size_t grow_pipe(int fd)
 {
-    int pipe_fd[2]; // Array to hold the file descriptors for the pipe
-    pid_t pid; // Variable to hold the process ID
+    fcntl(fd, F_SETPIPE_SZ, PIPE_CAPACITY); // Best effort: an unprivileged process may be limited to a smaller size
+    int size = fcntl(fd, F_GETPIPE_SZ);
+    return size > 0 ? (size_t)size : 65536;
+}
 
-    // Create a pipe
-    if (pipe(pipe_fd) == -1)
+// Copy exactly len bytes (or until EOF if len is 0) from in_fd to out_fd through user space.
+// Used only when out_fd does not support splice(), e.g. when it is a terminal.
+bool copy_bytes(int in_fd, int out_fd, size_t len)
+{
+    char buffer[65536]; // Buffer to hold data read from the pipe
+    bool until_eof = (len == 0);
+    while (until_eof || len > 0)
     {
-        perror("pipe"); // Print error if pipe creation fails
-        return 1;
+        size_t want = sizeof(buffer);
+        if (!until_eof && len < want)
+        {
+            want = len;
+        }
+        ssize_t bytes_read = read(in_fd, buffer, want);
+        if (bytes_read < 0)
+        {
+            if (errno == EINTR) continue;
+            perror("read");
+            return false;
+        }
+        if (bytes_read == 0)
+        {
+            return until_eof; // EOF before len bytes means the data went missing
+        }
+        for (ssize_t done = 0; done < bytes_read; )
+        {
+            ssize_t written = write(out_fd, buffer + done, bytes_read - done);
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                perror("write");
+                return false;
+            }
+            done += written;
+        }
+        if (!until_eof)
+        {
+            len -= bytes_read;
+        }
     }
+    return true;
+}
 
-    // Fork the process to create a child
-    pid = fork();
-    if (pid < 0)
+// Move exactly len bytes (or until EOF if len is 0) from the pipe in_fd to out_fd with splice().
+// If out_fd cannot be spliced into, the remaining data is copied with copy_bytes() instead.
+bool splice_bytes(int in_fd, int out_fd, size_t len, size_t chunk)
+{
+    bool until_eof = (len == 0);
+    while (until_eof || len > 0)
     {
-        perror("fork"); // Print error if fork fails
-        return 1;
+        size_t want = (until_eof || len > chunk) ? chunk : len;
+        ssize_t moved = splice(in_fd, NULL, out_fd, NULL, want, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL)
+            {
+                return copy_bytes(in_fd, out_fd, len); // Destination does not support splice()
+            }
+            perror("splice");
+            return false;
+        }
+        if (moved == 0)
+        {
+            return until_eof;
+        }
+        if (!until_eof)
+        {
+            len -= moved;
+        }
     }
+    return true;
+}
 
-    if (pid == 0)
-    { // Child process block
-        close(pipe_fd[0]); // Close the unused read end of the pipe
+// Duplicate everything arriving on the pipe in_fd to both file_fd and term_fd.
+// tee() copies the pipe contents into a second pipe without consuming them, then each copy is spliced to its destination.
+bool tee_to_both(int in_fd, int file_fd, int term_fd, size_t chunk)
+{
+    int tee_fd[2]; // Second pipe holding the copy headed for the terminal
+    if (pipe(tee_fd) == -1)
+    {
+        perror("pipe");
+        return false;
+    }
+    chunk = min(chunk, grow_pipe(tee_fd[1]));
 
-        // Message to write to the pipe
-        const char* msg = "Hello World\n";
-        write(pipe_fd[1], msg, strlen(msg)); // Write the message to the pipe
-        close(pipe_fd[1]); // Close the write end of the pipe
-        return 0; // Exit child process
-    } 
-    else
-    { // Parent process block
-        close(pipe_fd[1]); // Close the unused write end of the pipe
+    bool ok = true;
+    while (ok)
+    {
+        ssize_t copied = tee(in_fd, tee_fd[1], chunk, 0); // Blocks until the child writes or closes its end
+        if (copied < 0)
+        {
+            if (errno == EINTR) continue;
+            perror("tee");
+            ok = false;
+            break;
+        }
+        if (copied == 0)
+        {
+            break; // Child closed the write end and the pipe is drained
+        }
+        ok = splice_bytes(tee_fd[0], term_fd, copied, chunk) // Send the duplicate to the terminal
+          && splice_bytes(in_fd, file_fd, copied, chunk);    // Consume the original into the file
+    }
+
+    close(tee_fd[0]);
+    close(tee_fd[1]);
+    return ok;
+}
+
+// Write all len bytes of data to fd, retrying after partial writes
+bool write_all(int fd, const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            perror("write");
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+// Body of each child process: write its messages to the pipe
+void run_child(int write_fd, int index, int num_children)
+{
+    string msg = "Hello World\n";
+    if (num_children > 1)
+    {
+        msg = "Hello World from child " + to_string(index) + "\n"; // Tag the line so merged output shows its source
+    }
+    write_all(write_fd, msg.data(), msg.size());
+}
+
+// Read the pipes of all children at once with epoll and merge their output into out_fds.
+// Each pipe is drained into its own buffer and only complete lines are moved to the shared batch,
+// so lines from different children never interleave. The batch is written out in large writes.
+bool fan_in(const vector<int>& read_fds, const vector<int>& out_fds)
+{
+    const size_t BATCH_SIZE = 256 * 1024; // Flush the merged output once it reaches this size
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        perror("epoll_create1");
+        return false;
+    }
+
+    for (size_t i = 0; i < read_fds.size(); ++i)
+    {
+        fcntl(read_fds[i], F_SETFL, fcntl(read_fds[i], F_GETFL) | O_NONBLOCK); // Never block on one child while others have data
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u32 = i; // Remember which child the pipe belongs to
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, read_fds[i], &ev) == -1)
+        {
+            perror("epoll_ctl");
+            close(epoll_fd);
+            return false;
+        }
+    }
 
-        // Initialize flags for command-line arguments
-        bool output_to_file = false;
-        bool output_to_both = false;
+    vector<string> pending(read_fds.size()); // Partial line received from each child so far
+    string batch; // Complete lines waiting to be written
+    batch.reserve(BATCH_SIZE);
+    size_t open_pipes = read_fds.size();
+    bool ok = true;
 
-        // Process command-line arguments
-        for (int i = 1; i < argc; ++i)
+    // Write the batch to every destination and empty it
+    auto flush = [&]() {
+        for (int fd : out_fds)
         {
-            if (strcmp(argv[i], "-o") == 0)
+            ok = write_all(fd, batch.data(), batch.size()) && ok;
+        }
+        batch.clear();
+    };
+
+    epoll_event events[64];
+    char buffer[65536]; // Buffer to hold data read from a pipe
+    while (ok && open_pipes > 0)
+    {
+        int ready = epoll_wait(epoll_fd, events, 64, -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            ok = false;
+            break;
+        }
+
+        for (int e = 0; e < ready; ++e)
+        {
+            size_t source = events[e].data.u32;
+            string& line = pending[source];
+            bool eof = false;
+
+            // Drain everything the pipe currently holds
+            while (true)
             {
-                output_to_file = true; // Set flag for output to file
-            } else if (strcmp(argv[i], "-b") == 0)
+                ssize_t bytes_read = read(read_fds[source], buffer, sizeof(buffer));
+                if (bytes_read > 0)
+                {
+                    line.append(buffer, bytes_read);
+                    continue;
+                }
+                if (bytes_read == 0)
+                {
+                    eof = true; // Child closed its end of the pipe
+                }
+                else if (errno == EINTR)
+                {
+                    continue;
+                }
+                else if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    perror("read");
+                    eof = true;
+                    ok = false;
+                }
+                break;
+            }
+
+            // Move the complete lines into the batch, keeping any unterminated tail for later
+            size_t end = line.rfind('\n');
+            if (end != string::npos)
+            {
+                batch.append(line, 0, end + 1);
+                line.erase(0, end + 1);
+            }
+            if (eof)
             {
-                output_to_both = true; // Set flag for output to both
-                output_to_file = true; // -b implies -o
-            } else
+                if (!line.empty())
+                {
+                    batch.append(line).push_back('\n'); // Terminate the child's last line so it stays framed
+                    line.clear();
+                }
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, read_fds[source], NULL);
+                --open_pipes;
+            }
+            if (batch.size() >= BATCH_SIZE)
             {
-                print_usage(); // Print usage if unknown argument
-                return 1; // Exit with error
+                flush();
             }
         }
+    }
 
-        // Create or truncate output.txt if needed
-        int output_fd = -1;
-        if (output_to_file)
+    flush();
+    close(epoll_fd);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    // Initialize flags for command-line arguments
+    bool output_to_file = false;
+    bool output_to_both = false;
+    int num_children = 1;
+
+    // Process command-line arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-o") == 0)
+        {
+            output_to_file = true; // Set flag for output to file
+        } else if (strcmp(argv[i], "-b") == 0)
         {
-            output_fd = open("output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644); // Open file for writing
-            if (output_fd < 0)
+            output_to_both = true; // Set flag for output to both
+            output_to_file = true; // -b implies -o
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            num_children = atoi(argv[++i]); // Number of child processes to fork
+            if (num_children < 1)
             {
-                perror("open"); // Print error if file opening fails
+                print_usage();
                 return 1;
             }
+        } else
+        {
+            print_usage(); // Print usage if unknown argument
+            return 1; // Exit with error
         }
+    }
+
+    vector<int> read_fds; // Read end of each child's pipe
+    for (int child = 0; child < num_children; ++child)
+    {
+        int pipe_fd[2]; // Array to hold the file descriptors for the pipe
 
-        // Redirect the output based on flags
+        // Create a pipe
+        if (pipe(pipe_fd) == -1)
+        {
+            perror("pipe"); // Print error if pipe creation fails
+            return 1;
+        }
+
+        // Fork the process to create a child
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork"); // Print error if fork fails
+            return 1;
+        }
+
+        if (pid == 0)
+        { // Child process block
+            close(pipe_fd[0]); // Close the unused read end of the pipe
+            for (int fd : read_fds)
+            {
+                close(fd); // Read ends inherited from earlier children belong to the parent only
+            }
+            run_child(pipe_fd[1], child, num_children);
+            close(pipe_fd[1]); // Close the write end of the pipe
+            return 0; // Exit child process
+        }
+
+        close(pipe_fd[1]); // Close the unused write end of the pipe
+        read_fds.push_back(pipe_fd[0]);
+    }
+
+    // Parent process: create or truncate output.txt if needed
+    int output_fd = -1;
+    if (output_to_file)
+    {
+        output_fd = open("output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644); // Open file for writing
+        if (output_fd < 0)
+        {
+            perror("open"); // Print error if file opening fails
+            return 1;
+        }
+    }
+
+    if (output_to_both)
+    {
+        cout << "Redirected output to both terminal and file." << endl; // Notify user
+    }
+
+    bool ok;
+    if (num_children == 1)
+    {
+        int read_fd = read_fds[0];
+        size_t chunk = grow_pipe(read_fd); // Largest amount moved by a single splice()/tee() call
+
+        // A single source needs no framing, so move the data from the pipe without copying it
         if (output_to_both)
         {
-            // Duplicate the file descriptor to stdout
-            dup2(output_fd, STDOUT_FILENO); // Redirect to file
-            cout << "Redirected output to both terminal and file." << endl; // Notify user
-            dup2(output_fd, STDOUT_FILENO); // Redirect to file again
+            ok = tee_to_both(read_fd, output_fd, STDOUT_FILENO, chunk);
         } 
         else if (output_to_file)
         {
-            dup2(output_fd, STDOUT_FILENO); // Redirect to file only
+            ok = splice_bytes(read_fd, output_fd, 0, chunk); // Pipe to file only
         }
-
-        // Read from the pipe and print to stdout (or redirected output)
-        char buffer[256]; // Buffer to hold data read from the pipe
-        ssize_t bytes_read; // Variable to track number of bytes read
-        while ((bytes_read = read(pipe_fd[0], buffer, sizeof(buffer))) > 0)
+        else
         {
-            write(STDOUT_FILENO, buffer, bytes_read); // Write buffer contents to output
+            ok = splice_bytes(read_fd, STDOUT_FILENO, 0, chunk); // Pipe to the terminal
         }
-        
-        // Clean up resources
-        close(pipe_fd[0]); // Close read end of the pipe
-        if (output_fd >= 0)
+    }
+    else
+    {
+        // Several sources: multiplex the pipes and merge whole lines into the output
+        vector<int> out_fds;
+        if (output_to_file)
+        {
+            out_fds.push_back(output_fd);
+        }
+        if (!output_to_file || output_to_both)
         {
-            close(output_fd); // Close output file descriptor if opened
+            out_fds.push_back(STDOUT_FILENO);
         }
-        wait(NULL); // Wait for the child process to finish
+        ok = fan_in(read_fds, out_fds);
+    }
+    
+    // Clean up resources
+    for (int fd : read_fds)
+    {
+        close(fd); // Close read end of each pipe
+    }
+    if (output_fd >= 0)
+    {
+        close(output_fd); // Close output file descriptor if opened
     }
+    while (wait(NULL) > 0); // Wait for every child process to finish
 
-    return 0; // Exit the parent process
+    return ok ? 0 : 1; // Exit the parent process
 }
@@ -6,38 +6,391 @@ Description of Program:
 This program demonstrates the creation of two threads using the pthread library in C++. 
 Each thread will count from 0 to 10, and output each iteration of the count using `std::cout`. 
 The main function creates two threads, and then waits for both threads to finish before exiting.
+The counting now runs as two periodic tasks on the timer wheel from timer_wheel.h instead of two sleeping threads;
+`./thread_count timers [tasks]` schedules many such tasks to show they cost a few threads in total.
+Run as `./thread_count bench [iterations]` it instead measures the cost of creating and joining a thread
+and the latency of handing control back and forth between two threads using a mutex and condition variable,
+semaphores, a futex and pure spinning, with both threads pinned to the same core, sibling hyperthreads,
+different cores or different sockets. Latencies are reported as percentiles in nanoseconds.
 */
 
 #include <iostream>
+#include <iomanip>     // For std::setw
 #include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>     // For cpu_set_t and CPU_* macros
 #include <unistd.h> // For usleep
+#include <linux/futex.h>
+#include <sys/syscall.h> // For SYS_futex
+#include <ctime>       // For clock_gettime
+#include <atomic>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>   // For std::sort
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "timer_wheel.h"
 
-// Function for counting from 0 to 10 in each thread
-void* count(void* thread_id) {
-    long tid = (long)thread_id;  // Cast thread_id to long type for thread number
-    for (int i = 0; i <= 10; i++) {
-        std::cout << "Thread " << tid << " counting: " << i << std::endl;
-        usleep(100000); // Sleep to make output more readable by adding delay between iterations
+// State of one counter; every firing of its periodic timer prints the next number
+struct Counter {
+    long id;
+    int next;
+    TimerWheel::TimerId timer;
+};
+
+std::mutex done_mtx;                 // Protects counters_running
+std::condition_variable done_cv;     // Signalled when a counter finishes
+int counters_running = 0;
+
+// Timer callback for counting from 0 to 10, one step per firing. The wheel never overlaps two firings of
+// one timer and drops firings queued after the cancel, so counter needs no lock and finishes exactly once.
+void count(TimerWheel& wheel, Counter& counter) {
+    std::cout << "Thread " << counter.id << " counting: " << counter.next << std::endl;
+    if (++counter.next > 10) {
+        wheel.cancel(counter.timer);  // Done counting, stop the periodic timer
+        std::lock_guard<std::mutex> lock(done_mtx);
+        counters_running--;
+        done_cv.notify_all();
     }
-    pthread_exit(NULL); // Exit the thread safely
 }
 
-int main() {
-    pthread_t threads[2];  // Array to hold two thread objects
+// Current time of the monotonic clock in nanoseconds
+static inline long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-    // Creating two threads
-    for (long i = 0; i < 2; i++) {
-        int rc = pthread_create(&threads[i], NULL, count, (void*)i);  // Create threads and pass their ID
-        if (rc) {
-            std::cout << "Error: unable to create thread, " << rc << std::endl;
-            exit(-1);  // Exit if thread creation fails
+// Print the latency distribution of samples (in nanoseconds) on one line
+void print_percentiles(const std::string& label, std::vector<long long>& samples) {
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double p) { return samples[(size_t)(p * (samples.size() - 1))]; };
+    std::cout << std::left << std::setw(40) << label << std::right
+              << " p50 " << std::setw(8) << at(0.50)
+              << " p90 " << std::setw(8) << at(0.90)
+              << " p99 " << std::setw(8) << at(0.99)
+              << " p99.9 " << std::setw(8) << at(0.999)
+              << " max " << std::setw(10) << samples.back() << std::endl;
+}
+
+// Read a single integer from a sysfs file, or -1 if it is missing
+int read_sysfs_int(const std::string& path) {
+    std::ifstream file(path);
+    int value = -1;
+    file >> value;
+    return value;
+}
+
+// Where a CPU sits in the machine, as reported by sysfs
+struct CpuTopology {
+    int cpu;
+    int core;    // core_id, shared by sibling hyperthreads
+    int socket;  // physical_package_id
+};
+
+// A pair of CPUs the two benchmark threads are pinned to (-1 means not pinned)
+struct Placement {
+    std::string name;
+    int cpu_a;
+    int cpu_b;
+};
+
+// Pick one CPU pair for each placement the machine supports
+std::vector<Placement> find_placements() {
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    std::vector<CpuTopology> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        cpus.push_back({cpu, read_sysfs_int(dir + "core_id"), read_sysfs_int(dir + "physical_package_id")});
+    }
+
+    std::vector<Placement> placements = {{"unpinned", -1, -1}};
+    if (cpus.empty()) return placements;
+    placements.push_back({"same core", cpus[0].cpu, cpus[0].cpu});
+
+    const char* names[] = {"sibling hyperthreads", "different cores", "different sockets"};
+    bool found[3] = {false, false, false};
+    for (size_t i = 0; i < cpus.size(); i++) {
+        for (size_t j = i + 1; j < cpus.size(); j++) {
+            int kind;
+            if (cpus[i].socket != cpus[j].socket) kind = 2;
+            else if (cpus[i].core == cpus[j].core) kind = 0;
+            else kind = 1;
+            if (!found[kind]) {
+                found[kind] = true;
+                placements.push_back({names[kind], cpus[i].cpu, cpus[j].cpu});
+            }
+        }
+    }
+    return placements;
+}
+
+// Create a thread running fn(arg), pinned to cpu unless cpu is -1
+int start_thread(pthread_t* thread, void* (*fn)(void*), void* arg, int cpu) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+    int rc = pthread_create(thread, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return rc;
+}
+
+// Thread body that does nothing, used to time pthread_create/pthread_join
+void* empty_thread(void*) {
+    return NULL;
+}
+
+// Measure how long it takes to create a thread and join it again
+void bench_create_join(int iterations) {
+    std::vector<long long> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < iterations; i++) {
+        pthread_t thread;
+        long long start = now_ns();
+        if (pthread_create(&thread, NULL, empty_thread, NULL)) {
+            std::cout << "Error: unable to create thread" << std::endl;
+            return;
+        }
+        pthread_join(thread, NULL);
+        samples.push_back(now_ns() - start);
+    }
+    print_percentiles("pthread_create + pthread_join", samples);
+}
+
+// Synchronization primitives compared by the ping-pong benchmark
+enum Primitive { CONDVAR, SEMAPHORE, FUTEX, SPIN };
+const char* primitive_names[] = {"mutex+condvar", "semaphore", "futex", "spin"};
+
+static long futex(std::atomic<int>* addr, int op, int value) {
+    return syscall(SYS_futex, reinterpret_cast<int*>(addr), op, value, NULL, NULL, 0);
+}
+
+/*
+ * State shared by the two threads of a ping-pong run. turn says whose move it is:
+ * 0 for the ping thread, 1 for the pong thread. Each primitive passes the turn
+ * back and forth in its own way.
+ */
+struct PingPong {
+    Primitive primitive;
+    int iterations;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int turn;                    // Used by CONDVAR, protected by mutex
+    sem_t ping_sem, pong_sem;    // Used by SEMAPHORE
+    alignas(64) std::atomic<int> flag; // Used by FUTEX and SPIN
+    std::vector<long long> samples;
+};
+
+// Hand the turn to the other thread (to = 1 wakes pong, to = 0 wakes ping)
+void pass_turn(PingPong* pp, int to) {
+    switch (pp->primitive) {
+    case CONDVAR:
+        pthread_mutex_lock(&pp->mutex);
+        pp->turn = to;
+        pthread_cond_signal(&pp->cond);
+        pthread_mutex_unlock(&pp->mutex);
+        break;
+    case SEMAPHORE:
+        sem_post(to ? &pp->pong_sem : &pp->ping_sem);
+        break;
+    case FUTEX:
+        pp->flag.store(to, std::memory_order_release);
+        futex(&pp->flag, FUTEX_WAKE_PRIVATE, 1);
+        break;
+    case SPIN:
+        pp->flag.store(to, std::memory_order_release);
+        break;
+    }
+}
+
+// Block until it is the calling thread's turn (me = 0 for ping, 1 for pong)
+void await_turn(PingPong* pp, int me) {
+    switch (pp->primitive) {
+    case CONDVAR:
+        pthread_mutex_lock(&pp->mutex);
+        while (pp->turn != me) {
+            pthread_cond_wait(&pp->cond, &pp->mutex);
+        }
+        pthread_mutex_unlock(&pp->mutex);
+        break;
+    case SEMAPHORE:
+        sem_wait(me ? &pp->pong_sem : &pp->ping_sem);
+        break;
+    case FUTEX:
+        while (pp->flag.load(std::memory_order_acquire) != me) {
+            futex(&pp->flag, FUTEX_WAIT_PRIVATE, 1 - me); // Sleeps only while the flag still holds the other value
+        }
+        break;
+    case SPIN:
+        while (pp->flag.load(std::memory_order_acquire) != me) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
         }
+        break;
+    }
+}
+
+// Pong side: answer every ping
+void* pong_thread(void* arg) {
+    PingPong* pp = (PingPong*)arg;
+    for (int i = 0; i < pp->iterations; i++) {
+        await_turn(pp, 1);
+        pass_turn(pp, 0);
+    }
+    return NULL;
+}
+
+// Ping side: time each round trip and record half of it as the one-way handoff latency
+void* ping_thread(void* arg) {
+    PingPong* pp = (PingPong*)arg;
+    const int warmup = pp->iterations / 10; // Let caches, frequencies and futex state settle first
+    for (int i = 0; i < pp->iterations; i++) {
+        long long start = now_ns();
+        pass_turn(pp, 1);
+        await_turn(pp, 0);
+        if (i >= warmup) {
+            pp->samples.push_back((now_ns() - start) / 2);
+        }
+    }
+    return NULL;
+}
+
+// Run one ping-pong benchmark and print its latency percentiles
+void bench_ping_pong(Primitive primitive, const Placement& placement, int iterations) {
+    PingPong pp;
+    pp.primitive = primitive;
+    pp.iterations = iterations;
+    pthread_mutex_init(&pp.mutex, NULL);
+    pthread_cond_init(&pp.cond, NULL);
+    pp.turn = 0;
+    sem_init(&pp.ping_sem, 0, 0);
+    sem_init(&pp.pong_sem, 0, 0);
+    pp.flag.store(0);
+    pp.samples.reserve(iterations);
+
+    pthread_t ping, pong;
+    if (start_thread(&pong, pong_thread, &pp, placement.cpu_b) || start_thread(&ping, ping_thread, &pp, placement.cpu_a)) {
+        std::cout << "Error: unable to create thread" << std::endl;
+        exit(-1);
+    }
+    pthread_join(ping, NULL);
+    pthread_join(pong, NULL);
+
+    print_percentiles(std::string(primitive_names[primitive]) + ", " + placement.name, pp.samples);
+
+    pthread_mutex_destroy(&pp.mutex);
+    pthread_cond_destroy(&pp.cond);
+    sem_destroy(&pp.ping_sem);
+    sem_destroy(&pp.pong_sem);
+}
+
+// Run every benchmark and print the results
+void run_benchmarks(int iterations) {
+    std::cout << "Latencies in nanoseconds, " << iterations << " iterations each" << std::endl;
+    bench_create_join(iterations);
+
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    bool single_cpu = CPU_COUNT(&allowed) == 1;
+
+    for (const Placement& placement : find_placements()) {
+        for (int p = CONDVAR; p <= SPIN; p++) {
+            // Two spinning threads sharing one CPU only hand off when the scheduler preempts one of them
+            bool shared_cpu = (placement.cpu_a >= 0 && placement.cpu_a == placement.cpu_b) || single_cpu;
+            if (p == SPIN && shared_cpu) {
+                std::cout << std::left << std::setw(40) << ("spin, " + placement.name) << " skipped (threads share one CPU)" << std::endl;
+                continue;
+            }
+            bench_ping_pong((Primitive)p, placement, iterations);
+        }
+    }
+}
+
+// Schedule num_tasks periodic jobs on a few threads for one second and report how often they ran
+void run_timer_demo(int num_tasks) {
+    const auto period = std::chrono::milliseconds(100);
+    TimerWheel wheel(2);
+    std::atomic<long> firings(0);
+    std::vector<TimerWheel::TimerId> timers;
+    timers.reserve(num_tasks);
+
+    long long start = now_ns();
+    for (int i = 0; i < num_tasks; i++) {
+        auto phase = std::chrono::milliseconds(i % 100);  // Spread the first firings over one period
+        timers.push_back(wheel.schedule(phase, period, [&firings] { firings.fetch_add(1, std::memory_order_relaxed); }));
+    }
+    long long scheduled = now_ns();
+    usleep(1000000);
+    long long stopping = now_ns();
+    for (auto timer : timers) {
+        wheel.cancel(timer);
+    }
+    long long cancelled = now_ns();
+    wheel.stop();
+
+    std::cout << num_tasks << " periodic tasks on 1 tick thread + 2 workers" << std::endl;
+    std::cout << "schedule: " << (scheduled - start) / num_tasks << " ns/task, cancel: "
+              << (cancelled - stopping) / num_tasks << " ns/task" << std::endl;
+    long long elapsed_ms = (stopping - scheduled) / 1000000;
+    std::cout << "firings in " << elapsed_ms << " ms: " << firings.load()
+              << " (expected about " << num_tasks * elapsed_ms / 100 << ")" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    // ./thread_count bench [iterations] runs the microbenchmarks instead of the counting demo
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        int iterations = argc >= 3 ? atoi(argv[2]) : 100000;
+        if (iterations < 10) {
+            std::cout << "Usage: " << argv[0] << " [bench [iterations >= 10]]" << std::endl;
+            return 1;
+        }
+        run_benchmarks(iterations);
+        return 0;
+    }
+
+    // ./thread_count timers <tasks> shows how many periodic jobs the timer wheel can drive
+    if (argc >= 2 && strcmp(argv[1], "timers") == 0) {
+        int tasks = argc >= 3 ? atoi(argv[2]) : 100000;
+        if (tasks < 1) {
+            std::cout << "Usage: " << argv[0] << " [timers [tasks >= 1]]" << std::endl;
+            return 1;
+        }
+        run_timer_demo(tasks);
+        return 0;
+    }
+
+    TimerWheel wheel(2);   // Drives both counters; no thread sleeps per counter
+    Counter counters[2];   // Array to hold the two counters
+
+    // Start two counters, each stepping every 100 ms like the sleeping threads used to
+    counters_running = 2;
+    for (long i = 0; i < 2; i++) {
+        counters[i].id = i;
+        counters[i].next = 0;
+        Counter& counter = counters[i];
+        counters[i].timer = wheel.schedule(std::chrono::milliseconds(0), std::chrono::milliseconds(100),
+                                           [&wheel, &counter] { count(wheel, counter); });
     }
 
-    // Joining threads to ensure main waits for their completion
-    for (int i = 0; i < 2; i++) {
-        pthread_join(threads[i], NULL);  // Wait for each thread to finish
+    // Wait for both counters to finish
+    {
+        std::unique_lock<std::mutex> lock(done_mtx);
+        done_cv.wait(lock, [] { return counters_running == 0; });
     }
+    wheel.stop();
 
     pthread_exit(NULL);  // Exit main thread
 }
@@ -6,91 +6,363 @@ Description of Program:
 This program utilizes several threads to sum a number of integers from an input file. 
 The first element in the file is the number of elements to follow. Each thread sums a portion of the list, 
 and then the sums from all threads are totaled. The result is output to either the standard display or to "output.txt".
+With -index, the per-chunk partial sums are kept in a sidecar file "<input_file>.idx", so rerunning on a file that
+has only grown re-sums just the appended data; chunks whose checksum no longer matches are summed again.
+With -t, the elements are read as int8, int16, int32 (the default), int64, float or double. The list is summed in
+fixed blocks whose sums are totaled in order, so the result does not depend on the number of threads; floating-point
+blocks are summed pairwise and the block sums are totaled with Neumaier's compensated summation.
 */
 
 #include <iostream>     // For standard input/output
+#include <iomanip>      // For std::setprecision
 #include <fstream>      // For file input/output
 #include <thread>       // For using threads
 #include <vector>       // For storing numbers in a vector
-#include <mutex>        // For ensuring safe access to global_sum
+#include <algorithm>    // For std::min
+#include <charconv>     // For std::from_chars
+#include <cmath>        // For std::fabs
+#include <cstdint>      // For fixed-width integers
+#include <cstdio>       // For std::rename and std::remove
+#include <cstring>      // For std::memcpy
+#include <limits>       // For std::numeric_limits
+#include <fcntl.h>      // For open()
+#include <sys/mman.h>   // For mmap()
+#include <sys/stat.h>   // For fstat()
+#include <unistd.h>     // For close()
 
-std::mutex mtx; // To prevent race conditions when threads modify global_sum
-int global_sum = 0; // Global variable to hold the total sum of integers
+// Numbers are summed in blocks of this many elements; block sums are then totaled in order
+const size_t BLOCK_ELEMENTS = 4096;
 
-// Function executed by each thread to sum a portion of the array
-void sum_portion(const std::vector<int>& numbers, int start, int end) 
+/*
+ * Reductions for each element type. Every specialization provides:
+ * - Total: the type the sum is kept in
+ * - sum_block(): the sum of at most BLOCK_ELEMENTS numbers, written as simple loops over narrow
+ *   accumulators that the compiler turns into vector code of the matching width
+ * - Accumulator: totals block sums in order
+ */
+template <typename T>
+struct Reduction;
+
+// Integers: short runs are added in the narrowest accumulator that cannot overflow over the run,
+// so int8 and int16 elements are added many per instruction; runs are then widened to int64
+template <typename T, typename Run, size_t RUN_ELEMENTS>
+struct IntegerReduction
 {
-    int local_sum = 0;  // Variable to store the sum of the current portion
-    // Loop through the assigned portion and calculate the sum
-    for (int i = start; i < end; ++i) 
+    typedef int64_t Total;
+
+    static Total sum_block(const T* numbers, size_t count)
     {
-        local_sum += numbers[i];  // Add each element to local_sum
+        Total sum = 0;
+        for (size_t start = 0; start < count; start += RUN_ELEMENTS)
+        {
+            size_t end = std::min(count, start + RUN_ELEMENTS);
+            Run run = 0;
+            for (size_t i = start; i < end; ++i)
+            {
+                run += numbers[i];
+            }
+            sum += run;
+        }
+        return sum;
     }
-    // Lock the mutex to safely update the global sum
-    std::lock_guard<std::mutex> lock(mtx);
-    global_sum += local_sum;  // Add the local sum to the global sum
-}
 
-int main(int argc, char* argv[]) 
+    // Integer sums are exact, so block sums are simply added
+    struct Accumulator
+    {
+        Total sum = 0;
+        void add(Total block_sum) { sum += block_sum; }
+        Total result() const { return sum; }
+    };
+};
+
+template <> struct Reduction<int8_t> : IntegerReduction<int8_t, int16_t, 256> {};  // 256 * -128 still fits in int16
+template <> struct Reduction<int16_t> : IntegerReduction<int16_t, int32_t, BLOCK_ELEMENTS> {};
+template <> struct Reduction<int32_t> : IntegerReduction<int32_t, int64_t, BLOCK_ELEMENTS> {};
+template <> struct Reduction<int64_t> : IntegerReduction<int64_t, int64_t, BLOCK_ELEMENTS> {};
+
+// Floating point: each block is added into LANES independent partial sums, which are combined pairwise.
+// The order of additions is fixed, so the result is the same on every run and for every thread count.
+template <typename T, int LANES>
+struct FloatReduction
 {
-    // Check if the correct number of arguments (3) is passed: program name, number of threads, and input file
-    if (argc != 3) 
+    typedef double Total;
+
+    static Total sum_block(const T* numbers, size_t count)
     {
-        std::cerr << "Usage: " << argv[0] << " <number_of_threads> <input_file>" << std::endl;
-        return 1;  // Return an error if the correct arguments are not passed
+        T lanes[LANES] = {};
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            for (int lane = 0; lane < LANES; ++lane)
+            {
+                lanes[lane] += numbers[i + lane];
+            }
+        }
+        for (int lane = 0; lane < LANES && i + lane < count; ++lane)  // Leftover elements at the end of the list
+        {
+            lanes[lane] += numbers[i + lane];
+        }
+        for (int width = LANES / 2; width > 0; width /= 2)  // Combine the lanes pairwise
+        {
+            for (int lane = 0; lane < width; ++lane)
+            {
+                lanes[lane] += lanes[lane + width];
+            }
+        }
+        return lanes[0];
     }
 
-    int num_threads = std::stoi(argv[1]);  // Convert the argument to the number of threads
-    std::string file_name = argv[2];  // Store the input file name
+    // Neumaier's variant of Kahan summation: carries the low-order bits lost by each addition
+    struct Accumulator
+    {
+        double sum = 0;
+        double compensation = 0;
+        void add(double block_sum)
+        {
+            double t = sum + block_sum;
+            if (std::fabs(sum) >= std::fabs(block_sum)) compensation += (sum - t) + block_sum;
+            else compensation += (block_sum - t) + sum;
+            sum = t;
+        }
+        Total result() const { return sum + compensation; }
+    };
+};
 
-    // Open the input file for reading
-    std::ifstream input_file(file_name);
-    if (!input_file.is_open()) 
+template <> struct Reduction<float> : FloatReduction<float, 16> {};
+template <> struct Reduction<double> : FloatReduction<double, 8> {};
+
+// Function executed by each thread to sum a portion of the array: blocks [first_block, last_block)
+template <typename T>
+void sum_portion(const std::vector<T>& numbers, size_t first_block, size_t last_block, std::vector<typename Reduction<T>::Total>& block_sums)
+{
+    // Each block sum goes into its own slot, so no lock is needed and the totaling order is fixed
+    for (size_t block = first_block; block < last_block; ++block)
+    {
+        size_t start = block * BLOCK_ELEMENTS;
+        size_t count = std::min(BLOCK_ELEMENTS, numbers.size() - start);
+        block_sums[block] = Reduction<T>::sum_block(numbers.data() + start, count);
+    }
+}
+
+// An input file mapped into memory
+struct MappedFile
+{
+    const char* data = NULL;
+    uint64_t size = 0;
+};
+
+bool map_file(const std::string& file_name, MappedFile& file)
+{
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
     {
         std::cerr << "Error opening file " << file_name << std::endl;
-        return 1;  // Return an error if the file cannot be opened
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    file.size = st.st_size;
+    if (file.size > 0)
+    {
+        void* mapping = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            std::cerr << "Error mapping file " << file_name << std::endl;
+            close(fd);
+            return false;
+        }
+        file.data = static_cast<const char*>(mapping);
     }
+    close(fd);
+    return true;
+}
 
-    int num_elements;
-    input_file >> num_elements;  // First element is the number of remaining integers in the file
+void unmap_file(MappedFile& file)
+{
+    if (file.data) munmap(const_cast<char*>(file.data), file.size);
+    file.data = NULL;
+}
 
-    // Create a vector to store the integers from the file
-    std::vector<int> numbers(num_elements);
-    for (int i = 0; i < num_elements; ++i) 
+bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+enum ParseResult { PARSED, NO_MORE, NOT_A_NUMBER };
+
+// Parse the next number in [p, end) and advance p past it
+template <typename T>
+ParseResult parse_next(const char*& p, const char* end, T& value)
+{
+    while (p < end && is_space(*p)) ++p;  // Skip the whitespace between numbers
+    if (p == end) return NO_MORE;
+    if (*p == '+') ++p;  // from_chars only accepts a leading minus
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc() || (result.ptr < end && !is_space(*result.ptr)))
     {
-        input_file >> numbers[i];  // Read each number into the vector
+        return NOT_A_NUMBER;  // Not a number, out of range for T, or followed by something else
     }
-    input_file.close();  // Close the input file
+    p = result.ptr;
+    return PARSED;
+}
 
-    // If there are more threads than numbers, limit the number of threads to the number of elements
-    if (num_threads > num_elements) 
+// Read the element count at the start of the file; data_offset is set to the byte just after it
+bool read_element_count(const MappedFile& file, int64_t& num_elements, uint64_t& data_offset)
+{
+    const char* p = file.data;
+    if (parse_next(p, file.data + file.size, num_elements) != PARSED || num_elements < 0)
     {
-        num_threads = num_elements;
+        return false;
     }
+    data_offset = p - file.data;
+    return true;
+}
 
-    // Calculate how many elements each thread will handle
-    int elements_per_thread = num_elements / num_threads;
-    int remainder = num_elements % num_threads;  // Handle any remainder by giving some threads an extra element
+// Parse up to limit numbers from [begin, end) and sum them block by block, as the threads do for a whole list.
+// Returns false if it stops at a value that is not a T; count and sum then cover the values before it.
+template <typename T>
+bool sum_text(const char* begin, const char* end, uint64_t limit, uint64_t& count, typename Reduction<T>::Total& sum)
+{
+    typename Reduction<T>::Accumulator accumulator;
+    T block[BLOCK_ELEMENTS];
+    size_t filled = 0;
+    count = 0;
+    const char* p = begin;
+    bool valid = true;
+    while (count < limit)
+    {
+        ParseResult result = parse_next(p, end, block[filled]);
+        if (result == NOT_A_NUMBER) valid = false;
+        if (result != PARSED) break;
+        ++count;
+        if (++filled == BLOCK_ELEMENTS)
+        {
+            accumulator.add(Reduction<T>::sum_block(block, filled));
+            filled = 0;
+        }
+    }
+    if (filled > 0) accumulator.add(Reduction<T>::sum_block(block, filled));
+    sum = accumulator.result();
+    return valid;
+}
 
-    std::vector<std::thread> threads;  // Vector to store the threads
-    int start = 0;  // Start index for each thread
+/*
+ * Sidecar index for -index mode. The numbers after the element count are split into chunks of about
+ * CHUNK_BYTES. A chunk always ends just before a whitespace character, so where the chunks fall depends
+ * only on the bytes before each boundary and stays the same when data is appended to the file.
+ * The trailing partial chunk is summed on every run but never indexed, since it may still be growing.
+ * Blocks restart at each chunk, so floating-point sums in -index mode can differ from the plain mode
+ * in the last bits; each mode on its own gives the same result for any number of threads.
+ */
+const char INDEX_MAGIC[8] = {'S', 'U', 'M', 'I', 'D', 'X', '0', '2'};
+const uint64_t CHUNK_BYTES = 1 << 20;  // Nominal chunk size: 1 MiB
 
-    // Create threads and assign each one a portion of the array to sum
-    for (int i = 0; i < num_threads; ++i) 
+struct IndexHeader
+{
+    char magic[8];
+    uint64_t chunk_bytes;   // CHUNK_BYTES of the program that wrote the index
+    uint64_t data_offset;   // Byte just after the element count, where the first chunk starts
+    char element_type[8];   // -t type the sums were computed for
+    uint64_t num_chunks;    // Number of ChunkEntry records that follow
+};
+
+struct ChunkEntry
+{
+    uint64_t offset;    // Byte offset of the chunk in the input file
+    uint64_t length;    // Length of the chunk in bytes
+    uint64_t count;     // Number of elements in the chunk
+    uint64_t sum;       // Bytes of the chunk's Reduction<T>::Total (int64 or double)
+    uint64_t checksum;  // checksum_bytes() of the chunk's contents
+};
+
+// Fast 64-bit checksum of a byte range, eight bytes per step; much cheaper than parsing the same bytes
+uint64_t checksum_bytes(const char* data, uint64_t length)
+{
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    uint64_t hash = length * multiplier;
+    uint64_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+    for (; i < length; ++i)  // Remaining bytes one at a time
     {
-        // Determine the end index for the current thread's portion
-        int end = start + elements_per_thread + (i < remainder ? 1 : 0);  // Some threads may sum 1 extra element
-        threads.push_back(std::thread(sum_portion, std::ref(numbers), start, end));  // Create the thread
-        start = end;  // Update the start index for the next thread
+        hash = (hash ^ (unsigned char)data[i]) * multiplier;
+        hash ^= hash >> 29;
     }
+    return hash;
+}
 
-    // Wait for all threads to finish
-    for (auto& t : threads) 
+// Read the index for a file whose first chunk starts at data_offset; returns an empty list if there is none
+std::vector<ChunkEntry> load_index(const std::string& index_name, uint64_t data_offset, const std::string& type_name)
+{
+    std::vector<ChunkEntry> chunks;
+    std::ifstream index_file(index_name, std::ios::binary);
+    if (!index_file.is_open())
     {
-        t.join();  // Join each thread (i.e., wait for it to complete)
+        return chunks;  // No index yet
+    }
+
+    IndexHeader header;
+    if (!index_file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        header.chunk_bytes != CHUNK_BYTES || header.data_offset != data_offset ||
+        std::string(header.element_type, strnlen(header.element_type, sizeof(header.element_type))) != type_name)
+    {
+        return chunks;  // Not ours, written with other settings or element type, or the element count changed width
+    }
+
+    // The records must fill the rest of the file exactly; a corrupt count must not make us allocate for it
+    std::streamoff records_start = index_file.tellg();
+    index_file.seekg(0, std::ios::end);
+    uint64_t record_bytes = index_file.tellg() - records_start;
+    if (record_bytes % sizeof(ChunkEntry) != 0 || header.num_chunks != record_bytes / sizeof(ChunkEntry))
+    {
+        return chunks;  // Truncated or corrupt index
+    }
+    index_file.seekg(records_start);
+    chunks.resize(header.num_chunks);
+    if (!index_file.read(reinterpret_cast<char*>(chunks.data()), chunks.size() * sizeof(ChunkEntry)))
+    {
+        chunks.clear();  // Truncated index
+    }
+    return chunks;
+}
+
+// Write the index to a temporary file and rename it into place, so a reader never sees half an index
+bool save_index(const std::string& index_name, uint64_t data_offset, const std::string& type_name, const std::vector<ChunkEntry>& chunks)
+{
+    std::string temp_name = index_name + ".tmp";
+    std::ofstream index_file(temp_name, std::ios::binary | std::ios::trunc);
+    if (!index_file.is_open())
+    {
+        return false;
     }
 
-    // Output the result to both the console and the output file
+    IndexHeader header = {};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.chunk_bytes = CHUNK_BYTES;
+    header.data_offset = data_offset;
+    std::memcpy(header.element_type, type_name.c_str(), std::min(type_name.size(), sizeof(header.element_type)));
+    header.num_chunks = chunks.size();
+    index_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    index_file.write(reinterpret_cast<const char*>(chunks.data()), chunks.size() * sizeof(ChunkEntry));
+    index_file.close();
+    if (!index_file || std::rename(temp_name.c_str(), index_name.c_str()) != 0)
+    {
+        std::remove(temp_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Output the result to both the console and the output file
+template <typename Total>
+int write_total(Total total)
+{
     std::ofstream output_file("output.txt", std::ofstream::trunc);  // Open (or create) output.txt, truncate if it exists
     if (!output_file.is_open()) 
     {
@@ -98,9 +370,318 @@ int main(int argc, char* argv[])
         return 1;  // Return an error if the output file cannot be opened/created
     }
 
-    output_file << "Total sum: " << global_sum << std::endl;  // Write the total sum to output.txt
-    std::cout << "Total sum: " << global_sum << std::endl;  // Also print the total sum to the console
+    // Print floating-point totals with enough digits to tell any two results apart
+    output_file << std::setprecision(std::numeric_limits<Total>::max_digits10);
+    std::cout << std::setprecision(std::numeric_limits<Total>::max_digits10);
+    output_file << "Total sum: " << total << std::endl;  // Write the total sum to output.txt
+    std::cout << "Total sum: " << total << std::endl;  // Also print the total sum to the console
     output_file.close();  // Close the output file
 
     return 0;  // Program completed successfully
 }
+
+// Sum the file using and updating its sidecar index; the chunk work is spread over num_threads threads
+template <typename T>
+bool sum_with_index(const std::string& file_name, const std::string& type_name, int num_threads, typename Reduction<T>::Total& total)
+{
+    typedef typename Reduction<T>::Total Total;
+
+    // Map the input file; pages of chunks that are reused from the index are only read for their checksum
+    MappedFile file;
+    if (!map_file(file_name, file))
+    {
+        return false;
+    }
+    const char* data = file.data;
+    uint64_t file_size = file.size;
+
+    // The first element is the number of elements to sum; the chunks start right after it
+    int64_t num_elements;
+    uint64_t data_offset;
+    if (!read_element_count(file, num_elements, data_offset))
+    {
+        std::cerr << "Error reading the number of elements from " << file_name << std::endl;
+        unmap_file(file);
+        return false;
+    }
+
+    // Keep the indexed chunks up to the first one that no longer matches the file
+    std::string index_name = file_name + ".idx";
+    std::vector<ChunkEntry> chunks = load_index(index_name, data_offset, type_name);
+    size_t num_indexed = chunks.size();
+    std::vector<char> valid(chunks.size(), 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t)
+    {
+        threads.push_back(std::thread([&, t]() {
+            for (size_t i = t; i < chunks.size(); i += num_threads)
+            {
+                const ChunkEntry& chunk = chunks[i];
+                // A chunk is only valid if the whitespace that ended it is still in the file
+                valid[i] = chunk.offset + chunk.length < file_size && is_space(data[chunk.offset + chunk.length]) &&
+                           checksum_bytes(data + chunk.offset, chunk.length) == chunk.checksum;
+            }
+        }));
+    }
+    for (auto& t : threads) 
+    {
+        t.join();
+    }
+    threads.clear();
+
+    size_t reused = 0;
+    uint64_t next_offset = data_offset;
+    while (reused < chunks.size() && valid[reused] && chunks[reused].offset == next_offset)
+    {
+        next_offset += chunks[reused].length;
+        ++reused;
+    }
+    if (reused < chunks.size())
+    {
+        std::cout << "Index is out of date from chunk " << reused << "; summing the rest again" << std::endl;
+        chunks.resize(reused);
+    }
+
+    // Split the unindexed part of the file into new chunks; the last one is the unfinished tail
+    std::vector<ChunkEntry> fresh;
+    while (next_offset < file_size)
+    {
+        ChunkEntry chunk;
+        chunk.offset = next_offset;
+        uint64_t end = next_offset + CHUNK_BYTES;
+        while (end < file_size && !is_space(data[end])) ++end;  // Never split a number
+        if (end > file_size) end = file_size;
+        chunk.length = end - next_offset;
+        fresh.push_back(chunk);
+        next_offset = end;
+    }
+    bool has_tail = !fresh.empty() && next_offset == file_size;  // The last chunk was cut short by the end of the file
+
+    // Sum the new chunks in parallel; a chunk with a bad value records the elements before it
+    std::vector<char> bad(fresh.size(), 0);
+    for (int t = 0; t < num_threads; ++t)
+    {
+        threads.push_back(std::thread([&, t]() {
+            for (size_t i = t; i < fresh.size(); i += num_threads)
+            {
+                ChunkEntry& chunk = fresh[i];
+                Total sum;
+                bad[i] = !sum_text<T>(data + chunk.offset, data + chunk.offset + chunk.length, UINT64_MAX, chunk.count, sum);
+                std::memcpy(&chunk.sum, &sum, sizeof(sum));
+                chunk.checksum = checksum_bytes(data + chunk.offset, chunk.length);
+            }
+        }));
+    }
+    for (auto& t : threads) 
+    {
+        t.join();
+    }
+
+    // Total the chunks in order; only the first num_elements elements count, so a bad value after them
+    // is ignored, as in the plain mode
+    chunks.insert(chunks.end(), fresh.begin(), fresh.end());
+    bad.insert(bad.begin(), reused, 0);  // Indexed chunks were all good
+    uint64_t remaining = num_elements;
+    bool bad_value = false;
+    typename Reduction<T>::Accumulator accumulator;
+    for (size_t i = 0; i < chunks.size() && remaining > 0; ++i)
+    {
+        const ChunkEntry& chunk = chunks[i];
+        Total sum;
+        if (bad[i] && chunk.count < remaining)
+        {
+            bad_value = true;  // The bad value is one of the first num_elements
+            break;
+        }
+        if (chunk.count <= remaining && !bad[i])
+        {
+            std::memcpy(&sum, &chunk.sum, sizeof(sum));
+            remaining -= chunk.count;
+        }
+        else
+        {
+            // The element count ends inside this chunk: sum just the part before it
+            uint64_t count;
+            sum_text<T>(data + chunk.offset, data + chunk.offset + chunk.length, remaining, count, sum);
+            remaining = 0;
+        }
+        accumulator.add(sum);
+    }
+    total = accumulator.result();
+    unmap_file(file);
+
+    // Index every complete chunk for the next run, up to the first one with a bad value
+    size_t keep = has_tail ? chunks.size() - 1 : chunks.size();
+    for (size_t i = reused; i < keep; ++i)
+    {
+        if (bad[i]) keep = i;
+    }
+    chunks.resize(keep);
+    std::cout << "Reused " << reused << " indexed chunks, summed " << fresh.size() << " new chunks" << std::endl;
+    if ((chunks.size() != num_indexed || reused != num_indexed) && !save_index(index_name, data_offset, type_name, chunks))
+    {
+        std::cerr << "Warning: could not write " << index_name << std::endl;
+    }
+
+    // A bad value among the first num_elements, or a file with fewer elements than its count, is an error,
+    // as in the plain mode; the index is still kept
+    if (bad_value)
+    {
+        std::cerr << "Error: " << file_name << " contains a value that is not of type " << type_name << std::endl;
+        return false;
+    }
+    if (remaining > 0)
+    {
+        std::cerr << "Error: " << file_name << " has " << (num_elements - remaining) << " of " << num_elements << " elements" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Read the element count and that many elements of type T from the input file
+template <typename T>
+bool read_numbers(const std::string& file_name, const std::string& type_name, std::vector<T>& numbers)
+{
+    MappedFile file;
+    if (!map_file(file_name, file))
+    {
+        return false;
+    }
+
+    int64_t num_elements;  // First element is the number of remaining elements in the file
+    uint64_t data_offset;
+    if (!read_element_count(file, num_elements, data_offset))
+    {
+        std::cerr << "Error reading the number of elements from " << file_name << std::endl;
+        unmap_file(file);
+        return false;
+    }
+
+    numbers.resize(num_elements);
+    const char* p = file.data + data_offset;
+    for (int64_t i = 0; i < num_elements; ++i)
+    {
+        ParseResult result = parse_next(p, file.data + file.size, numbers[i]);  // Read each number into the vector
+        if (result != PARSED)
+        {
+            if (result == NOT_A_NUMBER) std::cerr << "Error: " << file_name << " contains a value that is not of type " << type_name << std::endl;
+            else std::cerr << "Error: " << file_name << " has " << i << " of " << num_elements << " elements" << std::endl;
+            unmap_file(file);
+            return false;
+        }
+    }
+    unmap_file(file);
+    return true;
+}
+
+// Sum the input file as elements of type T and write the result
+template <typename T>
+int sum_file(const std::string& file_name, const std::string& type_name, int num_threads, bool use_index)
+{
+    typedef typename Reduction<T>::Total Total;
+
+    if (use_index)
+    {
+        Total total;
+        if (!sum_with_index<T>(file_name, type_name, num_threads, total))
+        {
+            return 1;
+        }
+        return write_total(total);
+    }
+
+    // Create a vector to store the numbers from the file
+    std::vector<T> numbers;
+    if (!read_numbers(file_name, type_name, numbers))
+    {
+        return 1;  // Return an error if the file cannot be read
+    }
+
+    // The list is summed in fixed blocks; if there are more threads than blocks, limit the number of threads
+    size_t num_blocks = (numbers.size() + BLOCK_ELEMENTS - 1) / BLOCK_ELEMENTS;
+    if ((size_t)num_threads > num_blocks)
+    {
+        num_threads = std::max<size_t>(1, num_blocks);
+    }
+
+    // Calculate how many blocks each thread will handle
+    size_t blocks_per_thread = num_blocks / num_threads;
+    size_t remainder = num_blocks % num_threads;  // Handle any remainder by giving some threads an extra block
+
+    std::vector<Total> block_sums(num_blocks);
+    std::vector<std::thread> threads;  // Vector to store the threads
+    size_t start = 0;  // Start block for each thread
+
+    // Create threads and assign each one a portion of the array to sum
+    for (int i = 0; i < num_threads; ++i) 
+    {
+        // Determine the end block for the current thread's portion
+        size_t end = start + blocks_per_thread + ((size_t)i < remainder ? 1 : 0);  // Some threads may sum 1 extra block
+        threads.push_back(std::thread(sum_portion<T>, std::cref(numbers), start, end, std::ref(block_sums)));  // Create the thread
+        start = end;  // Update the start block for the next thread
+    }
+
+    // Wait for all threads to finish
+    for (auto& t : threads) 
+    {
+        t.join();  // Join each thread (i.e., wait for it to complete)
+    }
+
+    // Total the block sums in order, so the result is the same for any number of threads
+    typename Reduction<T>::Accumulator accumulator;
+    for (Total block_sum : block_sums)
+    {
+        accumulator.add(block_sum);
+    }
+    return write_total(accumulator.result());
+}
+
+int main(int argc, char* argv[]) 
+{
+    // Options come first: program name, [-index], [-t type], number of threads, and input file
+    bool use_index = false;
+    std::string type_name = "int32";
+    int arg = 1;
+    while (arg < argc && argv[arg][0] == '-')
+    {
+        std::string option = argv[arg];
+        if (option == "-index")
+        {
+            use_index = true;
+            arg++;
+        }
+        else if (option == "-t" && arg + 1 < argc)
+        {
+            type_name = argv[arg + 1];
+            arg += 2;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // Check if the correct number of arguments is left: number of threads and input file
+    if (argc - arg != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-index] [-t int8|int16|int32|int64|float|double] <number_of_threads> <input_file>" << std::endl;
+        return 1;  // Return an error if the correct arguments are not passed
+    }
+
+    int num_threads = std::stoi(argv[arg]);  // Convert the argument to the number of threads
+    std::string file_name = argv[arg + 1];  // Store the input file name
+    if (num_threads < 1)
+    {
+        num_threads = 1;
+    }
+
+    // Pick the reduction for the element type at compile time
+    if (type_name == "int8") return sum_file<int8_t>(file_name, type_name, num_threads, use_index);
+    if (type_name == "int16") return sum_file<int16_t>(file_name, type_name, num_threads, use_index);
+    if (type_name == "int32") return sum_file<int32_t>(file_name, type_name, num_threads, use_index);
+    if (type_name == "int64") return sum_file<int64_t>(file_name, type_name, num_threads, use_index);
+    if (type_name == "float") return sum_file<float>(file_name, type_name, num_threads, use_index);
+    if (type_name == "double") return sum_file<double>(file_name, type_name, num_threads, use_index);
+    std::cerr << "Unknown element type " << type_name << std::endl;
+    return 1;
+}
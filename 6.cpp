@@ -8,39 +8,271 @@ the number of producer threads and the number of consumer threads. Producers gen
 while consumers retrieve and consume those widgets from the buffer. To ensure synchronization and avoid issues like race conditions, the
 program employs semaphores and mutex locks to control access to the buffer. The goal of the program is to produce and consume at least 10 
 widgets per producer and consumer without deadlock or crashes. The output is displayed in the console and saved to a file, output.txt.
+With -steal, each consumer gets its own deque that producers feed directly, and idle consumers steal widgets from the others.
+Each widget carries a 64 B to 64 KiB payload allocated from its producer's slab pool; only a small handle passes through the buffer.
 */
 
 
 #include <iostream>
 #include <pthread.h>
 #include <queue>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <sched.h>
 #include <semaphore.h>
 #include <unistd.h>
 #include <fstream>
+#include "sync_metrics.h"
+#include "event_trace.h"
+#include "slab_pool.h"
 
 using namespace std;
 
+/*
+ * A widget carries a payload of 64 bytes to 64 KiB. The payload is allocated from the producing
+ * thread's slab pool (or with malloc when running with -malloc), and only this small handle
+ * travels through the buffer. The consumer releases the payload straight back to the owning pool.
+ */
+struct Widget {
+    int number;            // Widget number within its producer
+    int pool;              // Index of the producer's pool, or -1 if the payload came from malloc
+    uint32_t offset;       // Payload offset within the pool
+    char* heap_data;       // Payload allocated with malloc
+    uint32_t size;         // Payload size in bytes
+    uint64_t produced_ns;  // When the widget was produced, for measuring handoff latency
+};
+
+const size_t POOL_ARENA_MAX_BYTES = 64 << 20; // Cap on the arena reserved per producer; pages are only touched as used
+const size_t POOL_BLOCK_BYTES = SLAB_MAX_PAYLOAD + 64; // Largest payload plus room for its block header
+const uint64_t POOL_WAIT_NS = 1000000;     // How long an exhausted pool waits for consumers before falling back to malloc
+
+bool use_pools = true;        // Allocate payloads from per-producer slab pools rather than malloc
+bool benchmark = false;       // Skip the simulated delays and per-widget logging, and report allocation statistics
+int widgets_per_thread = 10;  // Widgets each producer produces and each consumer consumes
+vector<SlabPool*> pools;      // One pool per producer
+atomic<int> pool_fallbacks(0); // Payloads allocated with malloc because their producer's pool was exhausted
+vector<vector<uint64_t>> alloc_ns;   // Time spent allocating each payload, per producer
+vector<vector<uint64_t>> latency_ns; // Time from production to consumption of each widget, per consumer
+
 // Shared resources
-queue<int> buffer; // Infinite buffer for the purposes of this assignment
-sem_t full; // Semaphore for full slots
-pthread_mutex_t mutex; // Mutex lock for accessing the buffer
+queue<Widget> buffer; // Infinite buffer for the purposes of this assignment
+sync_metrics::Semaphore full("full", 0); // Semaphore for full slots, starting with no widgets in the buffer
+sync_metrics::Mutex buffer_mutex("buffer"); // Mutex lock for accessing the buffer
+sync_metrics::Gauge buffer_depth("buffer_depth"); // Number of widgets waiting in the buffer
 
 ofstream output_file("output.txt");
 
+/*
+ * Work-stealing distribution (-steal): instead of one shared buffer, every consumer owns a local deque.
+ * Producers append widgets to the back of one consumer's deque, chosen round-robin or, with -hash,
+ * always the same consumer for a given producer. The owner takes widgets from one end (the back for
+ * LIFO, the front for FIFO) and an idle consumer steals from the opposite end of another consumer's
+ * deque, so owners and thieves rarely meet. There is no shared counter on the hot path: a producer
+ * wakes only the owner of the deque it fed, through that deque's own semaphore. An idle consumer scans
+ * its own deque and then the others, and sleeps on its semaphore when all are empty. A widget is only
+ * removed under its deque's lock, so each is consumed exactly once; consumers exit when the global
+ * count of widgets still to be consumed reaches zero, and the consumer that takes the last one wakes the rest.
+ */
+struct LocalDeque {
+    deque<Widget> widgets;
+    sync_metrics::Mutex mtx;   // Protects widgets; shared only by the owner, producers and thieves of this deque
+    sync_metrics::Gauge depth; // Number of widgets waiting in this deque
+    sync_metrics::Semaphore wakeup; // Posted for every widget produced into this deque, and when all are consumed
+    LocalDeque(int owner) : mtx("deque_" + to_string(owner)), depth("deque_depth_" + to_string(owner)),
+                            wakeup("deque_wakeup_" + to_string(owner), 0) {}
+};
+
+bool work_stealing = false;  // Use per-consumer deques instead of the shared buffer
+bool owner_lifo = true;      // Owners pop their newest widget first; thieves take the oldest
+bool hash_affinity = false;  // Send all of a producer's widgets to the same consumer
+int num_producers;
+int num_consumers;
+vector<LocalDeque*> local_deques;
+atomic<int> steals(0);       // Widgets consumed by a consumer other than the one they were sent to
+atomic<int> widgets_remaining(0); // Widgets not yet consumed, across all deques
+sync_metrics::Mutex output_mutex("output"); // Serializes logging when there is no shared buffer lock
+
+// Trace events, recorded when TRACE_FILE is set
+const event_trace::EventType TRACE_PRODUCED = event_trace::define("produced widget");
+const event_trace::EventType TRACE_WAITING = event_trace::define("waiting for widget");
+const event_trace::EventType TRACE_CONSUMED = event_trace::define("consumed widget");
+const event_trace::EventType TRACE_STOLE = event_trace::define("stole widget");
+
+// Create widget number for a producer, filling a randomly sized payload
+Widget make_widget(int producer_id, int number, unsigned int& seed) {
+    Widget widget;
+    widget.number = number;
+    uint32_t largest = 64u << (rand_r(&seed) % SLAB_CLASSES); // Pick a size class, then a size within it
+    widget.size = max(64u, largest / 2 + 1 + rand_r(&seed) % (largest / 2));
+    widget.heap_data = NULL;
+    widget.offset = 0;
+
+    uint64_t start = sync_metrics::now_ns();
+    char* data = NULL;
+    if (use_pools) {
+        SlabPool* pool = pools[producer_id - 1];
+        while ((widget.offset = pool->allocate(widget.size)) == 0 && sync_metrics::now_ns() - start < POOL_WAIT_NS) {
+            sched_yield(); // Pool exhausted: give consumers a moment to release payloads
+        }
+        if (widget.offset != 0) {
+            widget.pool = producer_id - 1;
+            data = pool->data(widget.offset);
+        } else {
+            pool_fallbacks++; // Consumers are not keeping up, or have stopped; don't wait for them forever
+        }
+    }
+    if (data == NULL) {
+        widget.pool = -1;
+        data = widget.heap_data = (char*)malloc(widget.size);
+    }
+    alloc_ns[producer_id - 1].push_back(sync_metrics::now_ns() - start);
+
+    memset(data, number & 0xff, widget.size); // Produce the payload
+    widget.produced_ns = sync_metrics::now_ns();
+    return widget;
+}
+
+// Check a consumed widget's payload and release it to where it came from
+void finish_widget(int consumer_id, Widget& widget) {
+    latency_ns[consumer_id - 1].push_back(sync_metrics::now_ns() - widget.produced_ns);
+    char* data = widget.pool >= 0 ? pools[widget.pool]->data(widget.offset) : widget.heap_data;
+    if (data[0] != (char)(widget.number & 0xff) || data[widget.size - 1] != (char)(widget.number & 0xff)) {
+        cerr << "Consumer " << consumer_id << " found a corrupted payload in widget " << widget.number << endl;
+    }
+    if (widget.pool >= 0) {
+        pools[widget.pool]->release(widget.offset); // Lock-free return to the owning producer's pool
+    } else {
+        free(widget.heap_data);
+    }
+}
+
+// Write a message to the console and output.txt
+void log_message(const string& message) {
+    if (benchmark) {
+        return;
+    }
+    lock_guard<sync_metrics::Mutex> lock(output_mutex);
+    cout << message;
+    output_file << message;
+}
+
+// Consumer a producer sends its next widget to
+int pick_consumer(int producer_id, int number) {
+    if (hash_affinity) {
+        return hash<int>()(producer_id) % num_consumers;
+    }
+    return (producer_id + number) % num_consumers; // Round-robin, starting at a different consumer per producer
+}
+
+// Take a widget from a consumer's deque; the owner and thieves use opposite ends
+bool take_widget(int owner, bool stealing, Widget& widget) {
+    LocalDeque& local = *local_deques[owner];
+    lock_guard<sync_metrics::Mutex> lock(local.mtx);
+    if (local.widgets.empty()) {
+        return false;
+    }
+    if (owner_lifo != stealing) {
+        widget = local.widgets.back();
+        local.widgets.pop_back();
+    } else {
+        widget = local.widgets.front();
+        local.widgets.pop_front();
+    }
+    local.depth.set(local.widgets.size());
+    return true;
+}
+
+// Produce one widget into a consumer's deque (work-stealing mode)
+void produce_local(int id, const Widget& widget) {
+    LocalDeque& local = *local_deques[pick_consumer(id, widget.number)];
+    {
+        lock_guard<sync_metrics::Mutex> lock(local.mtx);
+        local.widgets.push_back(widget); // Produce widget
+        local.depth.set(local.widgets.size());
+    }
+    event_trace::instant(TRACE_PRODUCED, widget.number);
+    log_message("Producer " + to_string(id) + " produced widget " + to_string(widget.number) + " (" + to_string(widget.size) + " bytes)\n");
+    local.wakeup.post(); // Wake the deque's owner if it is idle
+}
+
+// Consume one widget, from the consumer's own deque if possible and otherwise by stealing (work-stealing mode).
+// Returns false once every widget has been consumed.
+bool consume_local(int id) {
+    int self = id - 1;
+    Widget widget;
+    while (true) {
+        if (widgets_remaining.load() == 0) {
+            return false;
+        }
+        bool found = take_widget(self, false, widget);
+        for (int v = 1; v < num_consumers && !found; v++) {
+            int victim = (self + v) % num_consumers;
+            if (take_widget(victim, true, widget)) {
+                found = true;
+                steals++;
+                event_trace::instant(TRACE_STOLE, victim + 1);
+            }
+        }
+        if (found) {
+            break;
+        }
+        // Every deque is empty: sleep until a producer feeds this one or the last widget is consumed
+        event_trace::begin(TRACE_WAITING, id);
+        local_deques[self]->wakeup.wait();
+        event_trace::end(TRACE_WAITING, id);
+    }
+    event_trace::instant(TRACE_CONSUMED, widget.number);
+    log_message("Consumer " + to_string(id) + " consumed widget " + to_string(widget.number) + " (" + to_string(widget.size) + " bytes)\n");
+    finish_widget(id, widget);
+
+    if (widgets_remaining.fetch_sub(1) == 1) {
+        for (LocalDeque* local : local_deques) {
+            local->wakeup.post(); // Let the idle consumers see that everything has been consumed
+        }
+    }
+    return true;
+}
+
+// Widgets a consumer consumes: 10 each, or when benchmarking an equal share of every widget produced
+int widgets_for_consumer(int id) {
+    if (!benchmark) {
+        return widgets_per_thread;
+    }
+    int total = num_producers * widgets_per_thread;
+    return total / num_consumers + (id - 1 < total % num_consumers ? 1 : 0);
+}
+
 // Function for producers to produce widgets
 void* producer(void* arg) {
     int id = *((int*)arg);
-    for (int i = 0; i < 10; i++) { // Each producer produces 10 widgets
-        pthread_mutex_lock(&mutex); // Lock the buffer access
+    event_trace::name_thread("Producer " + to_string(id));
+    unsigned int seed = id;
+    for (int i = 0; i < widgets_per_thread; i++) { // Each producer produces 10 widgets unless benchmarking
+        Widget widget = make_widget(id, i, seed);
+        if (work_stealing) {
+            produce_local(id, widget);
+            if (!benchmark) sleep(1); // Simulate time taken to produce a widget
+            continue;
+        }
+
+        buffer_mutex.lock(); // Lock the buffer access
 
-        buffer.push(i); // Produce widget
-        string message = "Producer " + to_string(id) + " produced widget " + to_string(i) + "\n";
-        cout << message;
-        output_file << message;
+        buffer.push(widget); // Produce widget
+        buffer_depth.set(buffer.size());
+        event_trace::instant(TRACE_PRODUCED, i);
+        if (!benchmark) {
+            string message = "Producer " + to_string(id) + " produced widget " + to_string(i) + " (" + to_string(widget.size) + " bytes)\n";
+            cout << message;
+            output_file << message;
+        }
 
-        pthread_mutex_unlock(&mutex); // Unlock the buffer
-        sem_post(&full); // Signal that a widget is available
-        sleep(1); // Simulate time taken to produce a widget
+        buffer_mutex.unlock(); // Unlock the buffer
+        full.post(); // Signal that a widget is available
+        if (!benchmark) sleep(1); // Simulate time taken to produce a widget
     }
     return NULL;
 }
@@ -48,39 +280,128 @@ void* producer(void* arg) {
 // Function for consumers to consume widgets
 void* consumer(void* arg) {
     int id = *((int*)arg);
-    for (int i = 0; i < 10; i++) { // Each consumer consumes 10 widgets
-        sem_wait(&full); // Wait if buffer is empty
-        pthread_mutex_lock(&mutex); // Lock the buffer access
+    event_trace::name_thread("Consumer " + to_string(id));
+    if (work_stealing) {
+        // Consumers share out every widget produced, however many each one ends up taking
+        while (consume_local(id)) {
+            if (!benchmark) sleep(1); // Simulate time taken to consume a widget
+        }
+        return NULL;
+    }
+
+    int count = widgets_for_consumer(id);
+    for (int i = 0; i < count; i++) { // Each consumer consumes 10 widgets unless benchmarking
+        event_trace::begin(TRACE_WAITING, id);
+        full.wait(); // Wait if buffer is empty
+        event_trace::end(TRACE_WAITING, id);
 
-        int widget = buffer.front();
+        buffer_mutex.lock(); // Lock the buffer access
+
+        Widget widget = buffer.front();
         buffer.pop(); // Consume widget
-        string message = "Consumer " + to_string(id) + " consumed widget " + to_string(widget) + "\n";
-        cout << message;
-        output_file << message;
+        buffer_depth.set(buffer.size());
+        event_trace::instant(TRACE_CONSUMED, widget.number);
+        if (!benchmark) {
+            string message = "Consumer " + to_string(id) + " consumed widget " + to_string(widget.number) + " (" + to_string(widget.size) + " bytes)\n";
+            cout << message;
+            output_file << message;
+        }
 
-        pthread_mutex_unlock(&mutex); // Unlock the buffer
-        sleep(1); // Simulate time taken to consume a widget
+        buffer_mutex.unlock(); // Unlock the buffer
+        finish_widget(id, widget); // Use the payload outside the lock, then release it
+        if (!benchmark) sleep(1); // Simulate time taken to consume a widget
     }
     return NULL;
 }
 
+// Print the command-line usage
+void print_usage(const char* program) {
+    cerr << "Usage: " << program << " <number_of_producers> <number_of_consumers> [-steal lifo|fifo] [-hash] [-malloc] [-bench <widgets>]" << endl;
+    cerr << " -steal  : Give each consumer its own deque and let idle consumers steal from the others." << endl;
+    cerr << " -hash   : With -steal, send all of a producer's widgets to the same consumer instead of round-robin." << endl;
+    cerr << " -malloc : Allocate widget payloads with malloc instead of per-producer slab pools." << endl;
+    cerr << " -bench  : Have each producer make <widgets> widgets, consume them all without delays or logging," << endl;
+    cerr << "           and report allocation cost and latency." << endl;
+}
+
+// Print a summary of the samples, in nanoseconds
+void print_percentiles(const string& label, vector<uint64_t>& samples) {
+    if (samples.empty()) {
+        return;
+    }
+    sort(samples.begin(), samples.end());
+    cout << label << ": p50 " << samples[samples.size() / 2] << " ns, p99 " << samples[samples.size() * 99 / 100]
+         << " ns, max " << samples.back() << " ns" << endl;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        cerr << "Usage: " << argv[0] << " <number_of_producers> <number_of_consumers>" << endl;
+    if (argc < 3) {
+        print_usage(argv[0]);
         return 1;
     }
 
-    int num_producers = atoi(argv[1]);
-    int num_consumers = atoi(argv[2]);
+    num_producers = atoi(argv[1]);
+    num_consumers = atoi(argv[2]);
 
-    // Initialize semaphores
-    sem_init(&full, 0, 0); // Start with no widgets in the buffer
-    pthread_mutex_init(&mutex, NULL);
+    // Process the optional distribution flags
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-steal") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "lifo") == 0 || strcmp(argv[i + 1], "fifo") == 0)) {
+            work_stealing = true;
+            owner_lifo = strcmp(argv[++i], "lifo") == 0;
+        } else if (strcmp(argv[i], "-hash") == 0) {
+            hash_affinity = true;
+        } else if (strcmp(argv[i], "-malloc") == 0) {
+            use_pools = false;
+        } else if (strcmp(argv[i], "-bench") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            benchmark = true;
+            widgets_per_thread = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (work_stealing && num_consumers < 1) {
+        cerr << "Work stealing needs at least one consumer." << endl;
+        return 1;
+    }
+    if (benchmark && num_consumers < 1) {
+        cerr << "Benchmarking needs at least one consumer." << endl;
+        return 1;
+    }
+    for (int i = 0; work_stealing && i < num_consumers; i++) {
+        local_deques.push_back(new LocalDeque(i + 1));
+    }
+    widgets_remaining = num_producers * widgets_per_thread;
+
+    // Give every producer its own payload pool
+    // Size each arena so a producer's whole run fits even if no payload is freed in time, up to the cap
+    size_t arena_bytes = min(POOL_ARENA_MAX_BYTES, (size_t)widgets_per_thread * POOL_BLOCK_BYTES);
+    arena_bytes = (arena_bytes + 63) & ~(size_t)63; // aligned_alloc wants a multiple of the alignment
+    for (int i = 0; use_pools && i < num_producers; i++) {
+        SlabPool* pool = (SlabPool*)aligned_alloc(64, SlabPool::bytes_for(arena_bytes));
+        if (pool == NULL) {
+            cerr << "Could not allocate a " << (arena_bytes >> 10) << " KiB payload pool for producer " << i + 1
+                 << "; try fewer producers or -malloc." << endl;
+            for (SlabPool* allocated : pools) {
+                free(allocated);
+            }
+            return 1;
+        }
+        pool->init(arena_bytes);
+        pools.push_back(pool);
+    }
+    alloc_ns.resize(num_producers);
+    latency_ns.resize(num_consumers);
+
+    sync_metrics::start_exporter(); // Export lock metrics if SYNC_METRICS_FILE is set
+    event_trace::start();           // Trace producers and consumers if TRACE_FILE is set
 
     // Create producer and consumer threads
     pthread_t producers[num_producers], consumers[num_consumers];
     int producer_ids[num_producers], consumer_ids[num_consumers];
 
+    uint64_t start_ns = sync_metrics::now_ns();
+
     // Create producer threads
     for (int i = 0; i < num_producers; i++) {
         producer_ids[i] = i + 1;
@@ -101,9 +422,31 @@ int main(int argc, char* argv[]) {
         pthread_join(consumers[i], NULL);
     }
 
-    // Destroy semaphores and mutex
-    sem_destroy(&full);
-    pthread_mutex_destroy(&mutex);
+    uint64_t elapsed_ns = sync_metrics::now_ns() - start_ns;
+
+    if (benchmark) {
+        vector<uint64_t> allocs, latencies;
+        for (auto& samples : alloc_ns) allocs.insert(allocs.end(), samples.begin(), samples.end());
+        for (auto& samples : latency_ns) latencies.insert(latencies.end(), samples.begin(), samples.end());
+        cout << "Payload allocator: " << (use_pools ? "per-producer slab pools" : "malloc") << endl;
+        cout << "Widgets: " << latencies.size() << " in " << elapsed_ns / 1000000 << " ms ("
+             << (uint64_t)(latencies.size() * 1e9 / max<uint64_t>(elapsed_ns, 1)) << " widgets/s)" << endl;
+        if (use_pools) {
+            cout << "Payloads allocated with malloc because a pool was exhausted: " << pool_fallbacks.load() << endl;
+        }
+        print_percentiles("Allocation time", allocs);
+        print_percentiles("Produce-to-consume latency", latencies);
+    }
+    for (SlabPool* pool : pools) {
+        free(pool);
+    }
+
+    if (work_stealing) {
+        cout << "Widgets stolen by idle consumers: " << steals.load() << endl;
+        for (LocalDeque* local : local_deques) {
+            delete local;
+        }
+    }
 
     output_file.close(); // Close the output file
 
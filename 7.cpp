@@ -1,87 +1,451 @@
 #include <iostream>
 #include <pthread.h>
 #include <semaphore.h>
-#include <queue>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
 #include <fstream>
+#include <algorithm>
+#include "sync_metrics.h"
+#include "slab_pool.h"
 
 using namespace std;
 
-// Shared buffer to store produced widgets
-queue<int> buffer;
+// Maximum number of items to produce and consume
+const int MAX_ITEMS = 10;
 
-// Buffer size passed as a command line argument
-int buffer_size;
+// Marks a shared buffer whose creator has finished initializing it
+const unsigned int BUFFER_MAGIC = 0x42554633;
 
-// Counter to keep track of the total number of produced items
-int item_count = 0;
+// Most processes that can use one shared buffer at the same time
+const int MAX_ATTACHED = 64;
 
-// Maximum number of items to produce and consume
-const int MAX_ITEMS = 10;
+// Payload pools in the buffer: each producer thread, in any process, holds one while it runs
+const int MIN_POOLS = 16; // The creator makes at least this many, and one per producer of its own
+const size_t POOL_ARENA_BYTES = 4 << 20; // Shared memory is only backed as it is touched
+
+/*
+ * An entry in the buffer: the widget's number plus a handle to its payload.
+ * The payload stays in the producer's pool; only the handle is copied through the buffer.
+ */
+struct Slot {
+    int item;         // The widget (a random number between 0 and 99)
+    int pool;         // Index of the pool holding the payload
+    uint32_t offset;  // Payload offset within that pool
+    uint32_t size;    // Payload size in bytes
+};
 
-// Mutex to lock critical sections and protect shared resources (buffer)
-pthread_mutex_t mutex;
+/*
+ * Bounded buffer shared by all producers and consumers:
+ * - It is placed in a shared mapping, so the same layout works between threads of one process
+ *   and between independent processes attached to a POSIX shared-memory segment
+ * - The mutex and semaphores are process-shared; an uncontended lock, post or wait stays in user space
+ * - head and tail only ever grow: tail is the number of items produced, head the number consumed,
+ *   and tail - head the number currently stored. An item is published by a single store to tail,
+ *   so a process that dies mid-update never leaves a half-written item behind
+ * - Each attached process has an entry in a table of pids, so the entries of processes
+ *   that crashed can be found and dropped
+ * - The slots follow the header in the same mapping, followed by num_pools payload pools.
+ *   Payloads are addressed by pool index and offset, so handles mean the same in every process.
+ *   Each pool is preceded by a cache line holding the pid of the process whose producer owns
+ *   it, or 0 if it is free; pools of exited or crashed producers are handed to new producers
+ */
+struct BoundedBuffer {
+    atomic<unsigned int> magic;  // Set to BUFFER_MAGIC once the buffer is ready to use
+    pid_t attached[MAX_ATTACHED]; // Processes using the buffer, 0 for a free entry; guarded by mutex
+    int capacity;                // Buffer size passed as a command line argument by the creator
+    pthread_mutex_t mutex;       // Robust mutex protecting head, tail and the items
+    sem_t empty_slots;           // Tracks empty slots in the buffer
+    sem_t full_slots;            // Tracks the number of items in the buffer
+    unsigned long head;          // Index of the next item to consume
+    unsigned long tail;          // Index of the next item to produce
+    int num_pools;               // Number of payload pools
+    size_t pools_offset;         // Offset of the first pool from the start of the buffer
+
+    Slot* items() { return reinterpret_cast<Slot*>(this + 1); }
+    atomic<pid_t>& pool_owner(int index) {
+        return *reinterpret_cast<atomic<pid_t>*>(reinterpret_cast<char*>(this) + pools_offset + index * (64 + SlabPool::bytes_for(POOL_ARENA_BYTES)));
+    }
+    SlabPool* pool(int index) {
+        return reinterpret_cast<SlabPool*>(reinterpret_cast<char*>(&pool_owner(index)) + 64);
+    }
+};
+
+// Shared buffer to store produced widgets
+BoundedBuffer* buffer;
+size_t buffer_bytes;
 
-// Semaphores to keep track of available slots in the buffer and the number of widgets
-sem_t empty_slots;  // Tracks empty slots in the buffer
-sem_t full_slots;   // Tracks the number of items in the buffer
+// Name of the shared-memory segment, empty when the buffer is private to this process
+string shm_name;
 
 // Output file for logging produced and consumed items
-ofstream output("output.txt");
+ofstream output;
+
+// Metrics for this process's use of the buffer; the buffer itself may be shared with other processes
+sync_metrics::LockStats buffer_lock_stats("buffer", "mutex");
+sync_metrics::LockStats empty_slots_stats("empty_slots", "semaphore");
+sync_metrics::LockStats full_slots_stats("full_slots", "semaphore");
+sync_metrics::Gauge buffer_depth("buffer_depth");
+thread_local uint64_t lock_acquired_at; // When the calling thread last took the buffer lock
+
+// Number of bytes needed for a buffer holding capacity items
+size_t pools_offset_for(int capacity) {
+    size_t slots_end = sizeof(BoundedBuffer) + capacity * sizeof(Slot);
+    return (slots_end + 63) & ~(size_t)63; // Pools are cache-line aligned
+}
+
+size_t buffer_size_for(int capacity, int num_pools) {
+    return pools_offset_for(capacity) + num_pools * (64 + SlabPool::bytes_for(POOL_ARENA_BYTES));
+}
+
+/*
+ * Marks every pool free and empty; only safe while no payload is in use
+ */
+void init_pools(BoundedBuffer* buf) {
+    for (int i = 0; i < buf->num_pools; i++) {
+        buf->pool_owner(i).store(0);
+        buf->pool(i)->init(POOL_ARENA_BYTES);
+    }
+}
+
+/*
+ * Initializes a freshly mapped buffer:
+ * - The mutex is process-shared and robust, so a process that dies while holding it
+ *   does not block everyone else forever
+ * - The semaphores are process-shared and start with all slots empty
+ */
+bool init_buffer(BoundedBuffer* buf, int capacity, int num_pools) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int rc = pthread_mutex_init(&buf->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (rc != 0) {
+        cerr << "pthread_mutex_init: " << strerror(rc) << endl;
+        return false;
+    }
+
+    if (sem_init(&buf->empty_slots, 1, capacity) == -1 || sem_init(&buf->full_slots, 1, 0) == -1) {
+        perror("sem_init");
+        return false;
+    }
+
+    buf->capacity = capacity;
+    buf->head = 0;
+    buf->tail = 0;
+    buf->num_pools = num_pools;
+    buf->pools_offset = pools_offset_for(capacity);
+    init_pools(buf);
+    memset(buf->attached, 0, sizeof(buf->attached)); // Processes add themselves in register_process()
+    buf->magic.store(BUFFER_MAGIC, memory_order_release); // Publish the buffer to waiting processes
+    return true;
+}
+
+/*
+ * Maps the shared-memory segment called name, creating it if it does not exist yet:
+ * - Every process takes an exclusive file lock on the segment while it checks it, so exactly one
+ *   process sizes and initializes it and the others wait for that one to finish
+ * - The kernel drops the lock of a process that dies, so if the process initializing the segment
+ *   crashes before publishing it, the next process to get the lock finds no BUFFER_MAGIC and
+ *   initializes the segment itself instead of waiting forever
+ * - Processes that attach to a published buffer use its capacity and pools
+ */
+BoundedBuffer* attach_shared_buffer(const char* name, int capacity, int num_pools) {
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd == -1) {
+        perror("shm_open");
+        return NULL;
+    }
+    if (flock(fd, LOCK_EX) == -1) {
+        perror("flock");
+        close(fd);
+        return NULL;
+    }
+
+    // Check whether the buffer has been published
+    struct stat st;
+    bool published = false;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(BoundedBuffer)) {
+        void* addr = mmap(NULL, sizeof(BoundedBuffer), PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            published = static_cast<BoundedBuffer*>(addr)->magic.load(memory_order_acquire) == BUFFER_MAGIC;
+            munmap(addr, sizeof(BoundedBuffer));
+        }
+    }
+
+    if (published) {
+        buffer_bytes = st.st_size;
+    } else {
+        // New segment, or one whose creator died before publishing it: size it for this process
+        buffer_bytes = buffer_size_for(capacity, num_pools);
+        if (ftruncate(fd, 0) == -1 || ftruncate(fd, buffer_bytes) == -1) { // Shrinking first discards any half-built state
+            perror("ftruncate");
+            close(fd);
+            shm_unlink(name);
+            return NULL;
+        }
+    }
+
+    void* addr = mmap(NULL, buffer_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return NULL;
+    }
+
+    BoundedBuffer* buf = static_cast<BoundedBuffer*>(addr);
+    if (!published && !init_buffer(buf, capacity, num_pools)) {
+        munmap(addr, buffer_bytes);
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    flock(fd, LOCK_UN); // Explicitly, since the mapping would otherwise keep the lock held
+    close(fd); // The mapping keeps the segment alive
+    return buf;
+}
+
+/*
+ * Locks the buffer, recovering it if the previous owner died inside the critical section:
+ * - head and tail are always consistent, because each is updated by a single store
+ * - The dead owner may have taken a semaphore token it never returned, so one token is
+ *   handed back on each semaphore; producers and consumers re-check the buffer under the
+ *   lock and simply retry when a token turns out to be spare
+ */
+void lock_buffer() {
+    int rc = pthread_mutex_trylock(&buffer->mutex);
+    if (rc == EBUSY) {
+        uint64_t start = sync_metrics::now_ns();
+        rc = pthread_mutex_lock(&buffer->mutex);
+        lock_acquired_at = sync_metrics::now_ns();
+        buffer_lock_stats.record_acquire(lock_acquired_at - start, true);
+    } else {
+        lock_acquired_at = sync_metrics::now_ns();
+        buffer_lock_stats.record_acquire(0, false);
+    }
+    if (rc == EOWNERDEAD) {
+        cerr << "Recovering buffer lock left behind by a crashed process" << endl;
+        sem_post(&buffer->empty_slots);
+        sem_post(&buffer->full_slots);
+        pthread_mutex_consistent(&buffer->mutex);
+    } else if (rc != 0) {
+        cerr << "pthread_mutex_lock: " << strerror(rc) << endl;
+        exit(1);
+    }
+}
+
+/*
+ * Unlocks the buffer and records how long it was held
+ */
+void unlock_buffer() {
+    buffer_lock_stats.record_hold(sync_metrics::now_ns() - lock_acquired_at);
+    pthread_mutex_unlock(&buffer->mutex);
+}
+
+/*
+ * True if the process is still running; a process of another user counts as running
+ */
+bool process_alive(pid_t pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/*
+ * Sets the semaphores to match head and tail; only safe while no other process uses the buffer
+ */
+void recount_semaphores() {
+    unsigned long stored = buffer->tail - buffer->head;
+    sem_destroy(&buffer->empty_slots);
+    sem_destroy(&buffer->full_slots);
+    sem_init(&buffer->empty_slots, 1, buffer->capacity - stored);
+    sem_init(&buffer->full_slots, 1, stored);
+}
+
+/*
+ * Records this process in the shared buffer's table of attached processes:
+ * - Entries of processes that died without detaching are dropped first
+ * - A process that finds no one else attached cleans up after the crashed ones: a buffer whose
+ *   run has finished is reset for a new run, otherwise the semaphores are recounted, since a
+ *   crashed process may have taken tokens it never returned
+ */
+bool register_process() {
+    lock_buffer();
+    int free_entry = -1;
+    int others = 0;
+    for (int i = 0; i < MAX_ATTACHED; i++) {
+        if (buffer->attached[i] != 0 && !process_alive(buffer->attached[i])) {
+            buffer->attached[i] = 0; // Crashed without detaching
+        }
+        if (buffer->attached[i] == 0) {
+            if (free_entry < 0) free_entry = i;
+        } else {
+            others++;
+        }
+    }
+    if (free_entry < 0) {
+        unlock_buffer();
+        cerr << "More than " << MAX_ATTACHED << " processes are using the shared buffer" << endl;
+        return false;
+    }
+    buffer->attached[free_entry] = getpid();
+
+    if (others == 0) {
+        if (buffer->head >= (unsigned long)MAX_ITEMS) {
+            // Left behind by an earlier run that did not clean up: start over
+            buffer->head = 0;
+            buffer->tail = 0;
+            init_pools(buffer);
+        }
+        recount_semaphores();
+    }
+    unlock_buffer();
+    return true;
+}
+
+/*
+ * Unmaps the buffer; the last live process to leave removes the shared-memory segment
+ */
+void detach_shared_buffer() {
+    bool last = true;
+    lock_buffer();
+    for (int i = 0; i < MAX_ATTACHED; i++) {
+        if (buffer->attached[i] == getpid()) {
+            buffer->attached[i] = 0;
+        } else if (buffer->attached[i] != 0 && process_alive(buffer->attached[i])) {
+            last = false;
+        }
+    }
+    unlock_buffer();
+    munmap(buffer, buffer_bytes);
+    if (last) {
+        shm_unlink(shm_name.c_str());
+    }
+}
+
+/*
+ * Gives the calling producer a payload pool of its own:
+ * - A free pool is taken over as it is, since consumers may still release payloads the previous
+ *   owner produced into it
+ * - A pool whose owner process crashed counts as free
+ * - If every pool is in use, the producer waits for one; it gets NULL if production ends first
+ */
+SlabPool* claim_pool(int& index) {
+    pid_t self = getpid();
+    while (true) {
+        for (index = 0; index < buffer->num_pools; index++) {
+            atomic<pid_t>& owner = buffer->pool_owner(index);
+            pid_t current = owner.load();
+            if (current == self || (current != 0 && process_alive(current))) {
+                continue; // Held by another producer
+            }
+            if (owner.compare_exchange_strong(current, self)) {
+                return buffer->pool(index);
+            }
+        }
+
+        lock_buffer();
+        bool finished = buffer->tail >= (unsigned long)MAX_ITEMS;
+        unlock_buffer();
+        if (finished) {
+            return NULL;
+        }
+        usleep(10000); // Wait for a producer to exit and give its pool back
+    }
+}
+
+/*
+ * Gives a producer's pool back when the producer exits
+ */
+void release_pool(int index) {
+    buffer->pool_owner(index).store(0);
+}
 
 /*
  * Producer thread function:
  * - Each producer thread produces a random widget (represented as a random integer)
+ *   with a payload of 64 bytes to 64 KiB allocated from its own pool
  * - The producer waits if the buffer is full
  * - The producer adds the widget to the buffer when space is available
- * - The producer stops after producing at least 10 items
+ * - Producers stop once MAX_ITEMS items have been produced in total
  */
 void* producer(void* id) {
     int producer_id = *(int*)id;
+    int pool_index;
+    SlabPool* pool = claim_pool(pool_index);
+    if (pool == NULL) {
+        pthread_exit(0); // Production ended while waiting for a pool
+    }
 
     while (true) {
         usleep(rand() % 1000000); // Simulate production time with random delay
 
-        // Produce an item (random number between 0 and 99)
-        int item = rand() % 100;
+        // Produce an item (random number between 0 and 99) and its payload
+        Slot slot;
+        slot.item = rand() % 100;
+        slot.pool = pool_index;
+        uint32_t largest = 64u << (rand() % SLAB_CLASSES); // Pick a size class, then a size within it
+        slot.size = max(64u, largest / 2 + 1 + rand() % (largest / 2));
+        while ((slot.offset = pool->allocate(slot.size)) == 0) {
+            usleep(1000); // Pool exhausted: wait for consumers to release payloads
+        }
+        memset(pool->data(slot.offset), slot.item, slot.size);
 
         // Wait if no empty slots are available (buffer is full)
-        sem_wait(&empty_slots);
+        sync_metrics::timed_sem_wait(&buffer->empty_slots, empty_slots_stats);
 
         // Lock the buffer to safely add the item (critical section)
-        pthread_mutex_lock(&mutex);
-
-        // If 10 items have already been produced, stop production
-        if (item_count >= MAX_ITEMS) {
-            pthread_mutex_unlock(&mutex);
-            sem_post(&empty_slots); // Release empty slot for other producers
+        lock_buffer();
+
+        // If all items have already been produced, stop production
+        if (buffer->tail >= (unsigned long)MAX_ITEMS) {
+            unlock_buffer();
+            pool->release(slot.offset);
+            sem_post(&buffer->empty_slots); // Release empty slot for other producers
+            sem_post(&buffer->full_slots);  // Wake a consumer so it can notice production is over
             break;
         }
 
+        // A spare token left by lock recovery; wait for a real empty slot
+        if (buffer->tail - buffer->head >= (unsigned long)buffer->capacity) {
+            unlock_buffer();
+            pool->release(slot.offset);
+            continue;
+        }
+
         // Add the produced item to the buffer
-        buffer.push(item);
-        item_count++;
+        buffer->items()[buffer->tail % buffer->capacity] = slot;
+        buffer->tail++;
+        buffer_depth.set(buffer->tail - buffer->head);
 
         // Log the produced item to standard display and to output.txt
-        cout << "Producer " << producer_id << " produced " << item << endl;
-        output << "Producer " << producer_id << " produced " << item << endl;
+        cout << "Producer " << producer_id << " produced " << slot.item << " (" << slot.size << " bytes)" << endl;
+        output << "Producer " << producer_id << " produced " << slot.item << " (" << slot.size << " bytes)" << endl;
 
         // Unlock the buffer after adding the item
-        pthread_mutex_unlock(&mutex);
+        unlock_buffer();
 
         // Signal that the buffer has a new full slot (item available for consumption)
-        sem_post(&full_slots);
+        sem_post(&buffer->full_slots);
     }
 
+    release_pool(pool_index);
     pthread_exit(0);
 }
 
 /*
  * Consumer thread function:
  * - Each consumer thread waits for an item to be available in the buffer
- * - The consumer removes the item from the buffer and processes it
- * - The consumer stops if there are no more items left to consume
+ * - The consumer removes the item from the buffer, processes its payload and releases
+ *   the payload back to the producer's pool without taking any lock
+ * - Consumers stop once MAX_ITEMS items have been consumed in total
  */
 void* consumer(void* id) {
     int consumer_id = *(int*)id;
@@ -90,35 +454,52 @@ void* consumer(void* id) {
         usleep(rand() % 1000000); // Simulate processing time with random delay
 
         // Wait if no items are available to consume (buffer is empty)
-        sem_wait(&full_slots);
+        sync_metrics::timed_sem_wait(&buffer->full_slots, full_slots_stats);
 
         // Lock the buffer to safely remove the item (critical section)
-        pthread_mutex_lock(&mutex);
+        lock_buffer();
 
         // If there are no more items left to consume, exit
-        if (item_count <= 0 && buffer.empty()) {
-            pthread_mutex_unlock(&mutex);
-            sem_post(&full_slots);  // Release the full slot for other consumers
+        if (buffer->head >= (unsigned long)MAX_ITEMS) {
+            unlock_buffer();
+            sem_post(&buffer->full_slots);  // Release the full slot for other consumers
             break;
         }
 
         // Consume the item if the buffer is not empty
-        if (!buffer.empty()) {
-            int item = buffer.front();
-            buffer.pop();  // Remove the item from the buffer
+        bool consumed = false;
+        Slot slot;
+        if (buffer->tail != buffer->head) {
+            slot = buffer->items()[buffer->head % buffer->capacity];
+            buffer->head++;  // Remove the item from the buffer
+            buffer_depth.set(buffer->tail - buffer->head);
 
             // Log the consumed item to standard display and to output.txt
-            cout << "Consumer " << consumer_id << " consumed " << item << endl;
-            output << "Consumer " << consumer_id << " consumed " << item << endl;
-
-            item_count--;
+            cout << "Consumer " << consumer_id << " consumed " << slot.item << " (" << slot.size << " bytes)" << endl;
+            output << "Consumer " << consumer_id << " consumed " << slot.item << " (" << slot.size << " bytes)" << endl;
+            consumed = true;
+
+            // The last item wakes the remaining consumers so they can exit
+            if (buffer->head >= (unsigned long)MAX_ITEMS) {
+                sem_post(&buffer->full_slots);
+            }
         }
 
         // Unlock the buffer after consuming the item
-        pthread_mutex_unlock(&mutex);
+        unlock_buffer();
 
         // Signal that the buffer has an empty slot (ready for new production)
-        sem_post(&empty_slots);
+        if (consumed) {
+            sem_post(&buffer->empty_slots);
+
+            // Process the payload outside the lock, then hand it back to its pool
+            SlabPool* pool = buffer->pool(slot.pool);
+            char* data = pool->data(slot.offset);
+            if (data[0] != (char)slot.item || data[slot.size - 1] != (char)slot.item) {
+                cerr << "Consumer " << consumer_id << " found a corrupted payload for item " << slot.item << endl;
+            }
+            pool->release(slot.offset);
+        }
     }
 
     pthread_exit(0);
@@ -127,26 +508,58 @@ void* consumer(void* id) {
 /*
  * Main function:
  * - Accepts command line arguments for the number of producers, consumers, and buffer size
- * - Initializes mutex and semaphores
+ * - With -shm <name>, attaches to (or creates) the named shared buffer so that producers and
+ *   consumers started as separate processes share one buffer
  * - Creates and manages producer and consumer threads
  * - Waits for all threads to complete and ensures clean-up
  */
 int main(int argc, char* argv[]) {
+    // An optional -shm <name> selects a buffer shared with other processes
+    if (argc == 6 && strcmp(argv[1], "-shm") == 0) {
+        shm_name = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+
     // Ensure the correct number of arguments are provided
     if (argc != 4) {
-        cout << "Usage: " << argv[0] << " <number_of_producers> <number_of_consumers> <buffer_size>" << endl;
+        cout << "Usage: " << argv[0] << " [-shm <name>] <number_of_producers> <number_of_consumers> <buffer_size>" << endl;
         return 1;
     }
 
     // Parse command line arguments
     int num_producers = atoi(argv[1]);
     int num_consumers = atoi(argv[2]);
-    buffer_size = atoi(argv[3]);
+    int buffer_size = atoi(argv[3]);
+    if (buffer_size < 1) {
+        cout << "Buffer size must be at least 1" << endl;
+        return 1;
+    }
 
-    // Initialize mutex and semaphores
-    pthread_mutex_init(&mutex, NULL);
-    sem_init(&empty_slots, 0, buffer_size);  // Initialize empty_slots with buffer size
-    sem_init(&full_slots, 0, 0);  // Initialize full_slots with 0 items
+    sync_metrics::start_exporter(); // Export lock metrics if SYNC_METRICS_FILE is set
+
+    // Map and initialize the buffer, its mutex and semaphores
+    int num_pools = max(MIN_POOLS, num_producers); // Every producer of this process can hold a pool at once
+    if (shm_name.empty()) {
+        buffer_bytes = buffer_size_for(buffer_size, num_pools);
+        void* addr = mmap(NULL, buffer_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        buffer = static_cast<BoundedBuffer*>(addr);
+        if (!init_buffer(buffer, buffer_size, num_pools)) {
+            return 1;
+        }
+        output.open("output.txt", ofstream::trunc);
+    } else {
+        buffer = attach_shared_buffer(shm_name.c_str(), buffer_size, num_pools);
+        if (buffer == NULL || !register_process()) {
+            return 1;
+        }
+        output.open("output.txt", ofstream::app); // Other processes log to the same file
+    }
+    srand(getpid()); // Processes sharing a buffer should not all produce the same items
 
     // Create producer and consumer threads
     pthread_t producers[num_producers], consumers[num_consumers];
@@ -175,9 +588,14 @@ int main(int argc, char* argv[]) {
     }
 
     // Cleanup resources
-    pthread_mutex_destroy(&mutex);
-    sem_destroy(&empty_slots);
-    sem_destroy(&full_slots);
+    if (shm_name.empty()) {
+        pthread_mutex_destroy(&buffer->mutex);
+        sem_destroy(&buffer->empty_slots);
+        sem_destroy(&buffer->full_slots);
+        munmap(buffer, buffer_bytes);
+    } else {
+        detach_shared_buffer();
+    }
     output.close();
 
     // Indicate successful completion
@@ -16,12 +16,21 @@ Output is displayed in the console.
 #include <vector>                  // For using vectors
 #include <chrono>                  // For sleep duration
 #include <condition_variable>       // For condition variables
+#include "sync_metrics.h"           // For the instrumented mutex and condition variable
+#include "event_trace.h"            // For tracing what each philosopher is doing
+
+// Trace events, recorded when TRACE_FILE is set
+const event_trace::EventType TRACE_THINKING = event_trace::define("thinking");
+const event_trace::EventType TRACE_WAITING = event_trace::define("waiting for utensils");
+const event_trace::EventType TRACE_ACQUIRED = event_trace::define("acquired utensils");
+const event_trace::EventType TRACE_EATING = event_trace::define("eating");
 
 class DiningPhilosophers {
 public:
     // Constructor to initialize the number of philosophers and utensils
     DiningPhilosophers(int num_philosophers, int num_utensils)
-        : philosophers(num_philosophers), utensils(num_utensils, true), eat_count(num_philosophers, 0) {}
+        : philosophers(num_philosophers), utensils(num_utensils, true), eat_count(num_philosophers, 0),
+          mtx("utensils"), cv("utensils") {}
 
     // Function to start the philosopher threads
     void start() {
@@ -40,11 +49,12 @@ private:
     int philosophers;                 // Number of philosophers
     std::vector<bool> utensils;      // Availability of utensils; true if available
     std::vector<int> eat_count;      // Count of how many times each philosopher has eaten
-    std::mutex mtx;                  // Mutex for synchronization
-    std::condition_variable cv;       // Condition variable for signaling between threads
+    sync_metrics::Mutex mtx;         // Mutex for synchronization
+    sync_metrics::CondVar cv;        // Condition variable for signaling between threads
 
     // Function representing the life of a philosopher
     void philosopher(int id) {
+        event_trace::name_thread("Philosopher " + std::to_string(id));
         while (eat_count[id] < 5) {  // Ensure each philosopher eats at least 5 times
             think(id);                // Philosopher thinks
             if (get_utensils(id)) {  // Try to get utensils
@@ -56,13 +66,15 @@ private:
 
     // Function to simulate thinking
     void think(int id) {
+        event_trace::Span span(TRACE_THINKING, id);
         std::cout << "Philosopher " << id << " is thinking." << std::endl;
         std::this_thread::sleep_for(std::chrono::milliseconds(rand() % 1000)); // Random sleep to simulate thinking time
     }
 
     // Function to acquire utensils
     bool get_utensils(int id) {
-        std::unique_lock<std::mutex> lock(mtx); // Acquire lock for thread safety
+        event_trace::begin(TRACE_WAITING, id);
+        std::unique_lock<sync_metrics::Mutex> lock(mtx); // Acquire lock for thread safety
         int left = id;                           // Index of the left utensil
         int right = (id + 1) % philosophers;    // Index of the right utensil
 
@@ -74,11 +86,14 @@ private:
         // Acquire both utensils
         utensils[left] = false;  // Take the left utensil
         utensils[right] = false; // Take the right utensil
+        event_trace::end(TRACE_WAITING, id);
+        event_trace::instant(TRACE_ACQUIRED, id);
         return true;
     }
 
     // Function to simulate eating
     void eat(int id) {
+        event_trace::Span span(TRACE_EATING, id);
         std::cout << "Philosopher " << id << " is eating." << std::endl;
         std::this_thread::sleep_for(std::chrono::milliseconds(rand() % 1000)); // Random sleep to simulate eating time
         eat_count[id]++;  // Increment the eating count for this philosopher
@@ -86,7 +101,7 @@ private:
 
     // Function to release utensils after eating
     void release_utensils(int id) {
-        std::unique_lock<std::mutex> lock(mtx); // Acquire lock for thread safety
+        std::unique_lock<sync_metrics::Mutex> lock(mtx); // Acquire lock for thread safety
         int left = id;                           // Index of the left utensil
         int right = (id + 1) % philosophers;    // Index of the right utensil
 
@@ -114,6 +129,9 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    sync_metrics::start_exporter(); // Export lock metrics if SYNC_METRICS_FILE is set
+    event_trace::start();           // Trace philosopher activity if TRACE_FILE is set
+
     // Create and start the Dining Philosophers simulation
     DiningPhilosophers dp(num_philosophers, num_utensils);
     dp.start();
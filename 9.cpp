@@ -16,6 +16,8 @@ The program runs until at least one complete group of reindeer and one group of
 #include <vector>
 #include <random>
 #include <chrono>
+#include "sync_metrics.h"
+#include "event_trace.h"
 
 using namespace std;
 
@@ -26,23 +28,35 @@ const int MAX_REINDEER = 9;
 const int MAX_ELVES = 3;
 
 // Mutex and condition variables
-mutex mtx;
-condition_variable santa_cv;
+sync_metrics::Mutex mtx("workshop");
+sync_metrics::CondVar santa_cv("santa");
 bool santa_available = true; // Indicates if Santa can help
 bool helped_reindeer = false;
 bool helped_elves = false;
 
+// Trace events, recorded when TRACE_FILE is set
+const event_trace::EventType TRACE_SANTA_SLEEPING = event_trace::define("Santa sleeping");
+const event_trace::EventType TRACE_HELPING_REINDEER = event_trace::define("Santa helping reindeer");
+const event_trace::EventType TRACE_HELPING_ELVES = event_trace::define("Santa helping elves");
+const event_trace::EventType TRACE_REINDEER_ARRIVED = event_trace::define("reindeer arrived");
+const event_trace::EventType TRACE_ELF_ARRIVED = event_trace::define("elf arrived");
+
 // Santa's function
 void Santa() {
+    event_trace::name_thread("Santa");
     while (!(helped_reindeer && helped_elves)) {
-        unique_lock<mutex> lock(mtx);
+        unique_lock<sync_metrics::Mutex> lock(mtx);
+        event_trace::begin(TRACE_SANTA_SLEEPING);
         santa_cv.wait(lock, [] { return !santa_available; }); // Wait until Santa is needed
+        event_trace::end(TRACE_SANTA_SLEEPING);
 
         if (reindeer_count == MAX_REINDEER) {
+            event_trace::Span span(TRACE_HELPING_REINDEER, reindeer_count);
             cout << "Santa is helping the reindeer!" << endl;
             helped_reindeer = true; // Mark that Santa helped reindeer
             reindeer_count = 0; // Reset reindeer count after helping
         } else if (elves_count == MAX_ELVES) {
+            event_trace::Span span(TRACE_HELPING_ELVES, elves_count);
             cout << "Santa is helping the elves!" << endl;
             helped_elves = true; // Mark that Santa helped elves
             elves_count = 0; // Reset elves count after helping
@@ -60,8 +74,9 @@ void Reindeer() {
         this_thread::sleep_for(chrono::milliseconds(rand() % 1000));
 
         {
-            lock_guard<mutex> lock(mtx);
+            lock_guard<sync_metrics::Mutex> lock(mtx);
             reindeer_count++;
+            event_trace::instant(TRACE_REINDEER_ARRIVED, reindeer_count);
             cout << "A reindeer has arrived! Total: " << reindeer_count << endl;
 
             // If we have enough reindeer, signal Santa
@@ -80,8 +95,9 @@ void Elf() {
         this_thread::sleep_for(chrono::milliseconds(rand() % 1000));
 
         {
-            lock_guard<mutex> lock(mtx);
+            lock_guard<sync_metrics::Mutex> lock(mtx);
             elves_count++;
+            event_trace::instant(TRACE_ELF_ARRIVED, elves_count);
             cout << "An elf has arrived! Total: " << elves_count << endl;
 
             // If we have enough elves and no reindeer waiting, signal Santa
@@ -94,6 +110,9 @@ void Elf() {
 }
 
 int main() {
+    sync_metrics::start_exporter(); // Export lock metrics if SYNC_METRICS_FILE is set
+    event_trace::start();           // Trace Santa, reindeer and elves if TRACE_FILE is set
+
     // Create Santa thread
     thread santa_thread(Santa);
 
@@ -0,0 +1,259 @@
+/*
+Description:
+Low-overhead event tracing for the thread programs. Each thread records compact binary events
+(timestamp counter, event type, phase, argument) into its own lock-free ring buffer, which costs a
+few nanoseconds and never blocks: if a ring is full the event is dropped and counted. A collector
+thread drains the rings every TRACE_FLUSH_MS milliseconds (default 100) and appends the events to
+the file named by the environment variable TRACE_FILE as Chrome trace JSON, which can be opened in
+chrome://tracing or ui.perfetto.dev. The array is closed at exit, but the viewers also accept a file
+whose program never exits, so a trace can be inspected while the program is still running.
+Tracing is off, and each call is a single branch, unless TRACE_FILE is set and start() is called.
+*/
+
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>       // For std::getenv
+#include <ctime>         // For clock_gettime
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>      // For getpid()
+#include <sys/syscall.h> // For SYS_gettid
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>   // For __rdtsc()
+#endif
+
+namespace event_trace {
+
+typedef uint16_t EventType;  // Index into the table of event names
+
+// One recorded event; the thread it belongs to is the owner of the ring it sits in
+struct Event {
+    uint64_t tsc;     // Timestamp counter when the event happened
+    EventType type;
+    char phase;       // 'B' begins a span, 'E' ends it, 'i' is an instant event
+    int32_t arg;      // Event-specific argument, such as a philosopher or widget number
+};
+
+const size_t RING_SIZE = 1 << 14;  // Events per thread between flushes; must be a power of two
+
+// Read the timestamp counter, or the monotonic clock where there is none
+inline uint64_t read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+inline uint64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Single-producer, single-consumer ring: the owning thread writes, the collector reads
+struct Ring {
+    alignas(64) std::atomic<uint64_t> head{0};  // Next slot the owner writes
+    alignas(64) std::atomic<uint64_t> tail{0};  // Next slot the collector reads
+    std::atomic<uint64_t> dropped{0};           // Events lost because the ring was full
+    long tid;
+    std::string thread_name;                    // Set by name_thread(); guarded by the tracer's mutex
+    Event events[RING_SIZE];
+};
+
+class Tracer {
+public:
+    static Tracer& instance() {
+        static Tracer* tracer = new Tracer();  // Never destroyed, so threads may trace during exit
+        return *tracer;
+    }
+
+    std::atomic<bool> enabled{false};
+
+    EventType define(const char* name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        names.push_back(name);
+        return names.size() - 1;
+    }
+
+    // The calling thread's ring, created the first time the thread records an event
+    Ring* ring() {
+        thread_local Ring* mine = nullptr;
+        if (mine == nullptr) {
+            mine = new Ring();  // Kept after the thread exits so its last events can still be flushed
+            mine->tid = syscall(SYS_gettid);
+            std::lock_guard<std::mutex> lock(mtx);
+            rings.push_back(mine);
+        }
+        return mine;
+    }
+
+    void name_thread(const std::string& name) {
+        Ring* r = ring();
+        std::lock_guard<std::mutex> lock(mtx);
+        r->thread_name = name;
+        renamed = true;
+    }
+
+    // Open the output file and start the collector thread
+    void start(const char* path, int flush_ms) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (out) return;
+        out = std::fopen(path, "w");
+        if (!out) {
+            std::perror("event_trace: fopen");
+            return;
+        }
+        std::fputs("[\n", out);
+        pid = getpid();
+        start_tsc = read_tsc();
+        start_ns = monotonic_ns();
+        this->flush_ms = flush_ms;
+        collector = std::thread(&Tracer::collect_loop, this);
+        enabled.store(true, std::memory_order_release);
+    }
+
+    // Stop recording, write the remaining events and close the JSON array
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!out || stopping) return;
+            enabled.store(false, std::memory_order_release);
+            stopping = true;
+        }
+        wake.notify_all();
+        collector.join();
+        std::lock_guard<std::mutex> lock(mtx);
+        flush_locked();
+        std::fputs("\n]\n", out);
+        std::fclose(out);
+        out = nullptr;
+    }
+
+private:
+    std::mutex mtx;                   // Protects everything below
+    std::condition_variable wake;
+    std::vector<const char*> names;
+    std::vector<Ring*> rings;
+    bool renamed = false;             // A thread name changed since the last flush
+    FILE* out = nullptr;
+    bool first_event = true;
+    bool stopping = false;
+    int flush_ms = 100;
+    long pid = 0;
+    uint64_t start_tsc = 0, start_ns = 0;
+    std::thread collector;
+
+    void collect_loop() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (!wake.wait_for(lock, std::chrono::milliseconds(flush_ms), [this] { return stopping; })) {
+            flush_locked();
+        }
+    }
+
+    void separator() {
+        if (!first_event) std::fputs(",\n", out);
+        first_event = false;
+    }
+
+    // Convert everything recorded so far to JSON; called with mtx held
+    void flush_locked() {
+        // Calibrate the timestamp counter against the monotonic clock over the whole run so far
+        uint64_t tsc_now = read_tsc(), ns_now = monotonic_ns();
+        double ns_per_tick = tsc_now > start_tsc ? (double)(ns_now - start_ns) / (tsc_now - start_tsc) : 1.0;
+
+        if (renamed) {
+            for (Ring* r : rings) {
+                if (r->thread_name.empty()) continue;
+                separator();
+                std::fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+                             pid, r->tid, r->thread_name.c_str());
+            }
+            renamed = false;
+        }
+
+        for (Ring* r : rings) {
+            uint64_t tail = r->tail.load(std::memory_order_relaxed);
+            uint64_t head = r->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                const Event& e = r->events[tail & (RING_SIZE - 1)];
+                double us = ((int64_t)(e.tsc - start_tsc)) * ns_per_tick / 1000.0;
+                separator();
+                std::fprintf(out, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%ld,\"tid\":%ld%s,\"args\":{\"arg\":%d}}",
+                             names[e.type], e.phase, us, pid, r->tid, e.phase == 'i' ? ",\"s\":\"t\"" : "", e.arg);
+            }
+            r->tail.store(tail, std::memory_order_release);
+
+            uint64_t dropped = r->dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped) {
+                separator();
+                std::fprintf(out, "{\"name\":\"dropped events\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%ld,\"tid\":%ld,\"args\":{\"dropped\":%llu}}",
+                             (ns_now - start_ns) / 1000.0, pid, r->tid, (unsigned long long)dropped);
+            }
+        }
+        std::fflush(out);
+    }
+};
+
+// Register an event name; call once per kind of event, typically at namespace scope
+inline EventType define(const char* name) {
+    return Tracer::instance().define(name);
+}
+
+// Record an event in the calling thread's ring
+inline void record(EventType type, char phase, int32_t arg) {
+    Tracer& tracer = Tracer::instance();
+    if (!tracer.enabled.load(std::memory_order_relaxed)) return;
+    Ring* r = tracer.ring();
+    uint64_t head = r->head.load(std::memory_order_relaxed);
+    if (head - r->tail.load(std::memory_order_acquire) == RING_SIZE) {
+        r->dropped.fetch_add(1, std::memory_order_relaxed);  // Never wait for the collector
+        return;
+    }
+    r->events[head & (RING_SIZE - 1)] = Event{read_tsc(), type, phase, arg};
+    r->head.store(head + 1, std::memory_order_release);
+}
+
+inline void begin(EventType type, int32_t arg = 0) { record(type, 'B', arg); }
+inline void end(EventType type, int32_t arg = 0) { record(type, 'E', arg); }
+inline void instant(EventType type, int32_t arg = 0) { record(type, 'i', arg); }
+
+// Name the calling thread in the trace viewer
+inline void name_thread(const std::string& name) {
+    if (Tracer::instance().enabled.load(std::memory_order_relaxed)) Tracer::instance().name_thread(name);
+}
+
+// Records a span covering the lifetime of the object
+class Span {
+public:
+    Span(EventType type, int32_t arg = 0) : type(type), arg(arg) { begin(type, arg); }
+    ~Span() { end(type, arg); }
+
+private:
+    EventType type;
+    int32_t arg;
+};
+
+// Start tracing if TRACE_FILE is set; call once at the start of main. The trace is completed at exit.
+inline void start() {
+    const char* path = std::getenv("TRACE_FILE");
+    if (path == nullptr || *path == '\0') return;
+    const char* flush = std::getenv("TRACE_FLUSH_MS");
+    int flush_ms = flush ? std::atoi(flush) : 100;
+    Tracer::instance().start(path, flush_ms > 0 ? flush_ms : 100);
+    std::atexit([] { Tracer::instance().stop(); });
+}
+
+}  // namespace event_trace
+
+#endif
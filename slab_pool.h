@@ -0,0 +1,104 @@
+/*
+Description:
+A per-producer slab allocator for variable-size message payloads (64 bytes to 64 KiB). Each producer
+owns one SlabPool and is the only one that allocates from it; any other thread, or any other process
+sharing the memory, can free a block back into it without taking a lock. Blocks are sorted into eleven
+power-of-two size classes. The owner keeps a private free list per class and refills it by taking the
+whole list of remotely freed blocks in one atomic exchange, so the pool never needs a global allocator lock.
+All links are offsets from the start of the pool, so a pool placed in shared memory works in every
+process that maps it, wherever the mapping lands.
+*/
+
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+const int SLAB_CLASSES = 11;          // 64, 128, ..., 65536 bytes
+const int SLAB_MIN_SHIFT = 6;         // Smallest class holds 64 bytes
+const uint32_t SLAB_MAX_PAYLOAD = 1u << (SLAB_MIN_SHIFT + SLAB_CLASSES - 1);
+
+class SlabPool {
+public:
+    // Bytes to reserve for a pool whose blocks may use up to arena_bytes
+    static size_t bytes_for(size_t arena_bytes) {
+        return sizeof(SlabPool) + arena_bytes;
+    }
+
+    // Prepare a pool at the start of bytes_for(arena_bytes) bytes of memory
+    void init(size_t arena_bytes) {
+        end = sizeof(SlabPool) + arena_bytes;
+        bump = sizeof(SlabPool);
+        for (int c = 0; c < SLAB_CLASSES; ++c) {
+            local_free[c] = 0;
+            remote_free[c].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Allocate room for size bytes; returns the payload's offset, or 0 if the pool is exhausted.
+    // Only the owning producer may call this.
+    uint32_t allocate(uint32_t size) {
+        int size_class = class_for(size);
+        if (size_class < 0) return 0;
+
+        uint32_t block = local_free[size_class];
+        if (block == 0) {
+            // Take back everything consumers have freed since the last refill
+            block = remote_free[size_class].exchange(0, std::memory_order_acquire);
+        }
+        if (block != 0) {
+            local_free[size_class] = header(block)->next;
+        } else {
+            // Carve a new block from the untouched part of the arena
+            uint32_t block_bytes = sizeof(BlockHeader) + (1u << (SLAB_MIN_SHIFT + size_class));
+            if (end - bump < block_bytes) return 0;
+            block = bump;
+            bump += block_bytes;
+            header(block)->size_class = size_class;
+        }
+        return block + sizeof(BlockHeader);
+    }
+
+    // Return a payload to the pool; safe to call from any thread or process
+    void release(uint32_t payload) {
+        uint32_t block = payload - sizeof(BlockHeader);
+        BlockHeader* h = header(block);
+        std::atomic<uint32_t>& head = remote_free[h->size_class];
+        uint32_t next = head.load(std::memory_order_relaxed);
+        do {
+            h->next = next;
+        } while (!head.compare_exchange_weak(next, block, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Address of the payload at offset
+    char* data(uint32_t payload) {
+        return reinterpret_cast<char*>(this) + payload;
+    }
+
+private:
+    struct alignas(16) BlockHeader {
+        uint32_t next;        // Next free block in the same class, 0 at the end of the list
+        uint32_t size_class;
+    };
+
+    uint32_t end;                                   // Offset just past the arena
+    uint32_t bump;                                  // Start of the never-used part of the arena (owner only)
+    uint32_t local_free[SLAB_CLASSES];              // Owner's free lists (owner only)
+    alignas(64) std::atomic<uint32_t> remote_free[SLAB_CLASSES];  // Blocks freed by consumers
+
+    BlockHeader* header(uint32_t block) {
+        return reinterpret_cast<BlockHeader*>(reinterpret_cast<char*>(this) + block);
+    }
+
+    // Smallest class that holds size bytes, or -1 if it is too large
+    static int class_for(uint32_t size) {
+        for (int c = 0; c < SLAB_CLASSES; ++c) {
+            if (size <= (1u << (SLAB_MIN_SHIFT + c))) return c;
+        }
+        return -1;
+    }
+};
+
+#endif
@@ -0,0 +1,406 @@
+/*
+Description:
+Lock-contention and queue-depth metrics for the synchronization programs. sync_metrics::Mutex,
+sync_metrics::CondVar and sync_metrics::Semaphore are drop-in replacements for std::mutex,
+std::condition_variable and sem_t. They count acquisitions and contended acquisitions, and keep
+log2-bucketed histograms of wait time and hold time. sync_metrics::Gauge tracks a value such as
+a buffer's depth, along with the highest value seen. Counters are spread over per-thread shards
+so the instrumentation does not become a new point of contention.
+If the environment variable SYNC_METRICS_FILE is set, start_exporter() rewrites that file in
+Prometheus text format every SYNC_METRICS_INTERVAL_MS milliseconds (default 1000) and once more at exit.
+A lock that is destroyed keeps its final counts in the export.
+*/
+
+#ifndef SYNC_METRICS_H
+#define SYNC_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>       // For std::rename
+#include <cstdlib>      // For std::getenv
+#include <ctime>        // For clock_gettime
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <semaphore.h>
+
+namespace sync_metrics {
+
+const int SHARDS = 64;   // Threads are spread over this many counter shards
+const int BUCKETS = 32;  // Histogram bucket i counts durations below 2^i ns (the last one is unbounded)
+
+// Current time of the monotonic clock in nanoseconds
+inline uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Shard used by the calling thread, assigned round-robin the first time the thread records anything
+inline int shard_index() {
+    static std::atomic<int> next_shard(0);
+    thread_local int index = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return index;
+}
+
+// Histogram bucket for a duration: the number of bits needed to hold it
+inline int bucket_for(uint64_t ns) {
+    int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+    return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+// Counters for one lock, written by the threads that map to this shard
+struct alignas(64) LockShard {
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> wait_ns{0};
+    std::atomic<uint64_t> hold_ns{0};
+    std::atomic<uint64_t> holds{0};
+    std::atomic<uint64_t> wait_buckets[BUCKETS] = {};
+    std::atomic<uint64_t> hold_buckets[BUCKETS] = {};
+};
+
+// Totals of one lock's counters at a point in time
+struct LockSnapshot {
+    std::string name, kind;
+    uint64_t acquisitions = 0, contended = 0, wait_ns = 0, hold_ns = 0, holds = 0;
+    uint64_t wait_buckets[BUCKETS] = {}, hold_buckets[BUCKETS] = {};
+};
+
+// A gauge's value and highest value at a point in time
+struct GaugeSnapshot {
+    std::string name;
+    int64_t value = 0, max = 0;
+};
+
+class LockStats;
+class Gauge;
+
+// Every live LockStats and Gauge, so the exporter can find them
+class Registry {
+public:
+    static Registry& instance() {
+        static Registry* registry = new Registry();  // Never destroyed, so globals can unregister at exit
+        return *registry;
+    }
+
+    void add(LockStats* stats) { std::lock_guard<std::mutex> lock(mtx); locks.push_back(stats); }
+    void add(Gauge* gauge) { std::lock_guard<std::mutex> lock(mtx); gauges.push_back(gauge); }
+    void remove(LockStats* stats);
+    void remove(Gauge* gauge);
+
+    // Write every metric in Prometheus text exposition format
+    void write_prometheus(std::ostream& out);
+
+private:
+    std::mutex mtx;
+    std::vector<LockStats*> locks;
+    std::vector<LockSnapshot> retired;  // Final counts of locks that no longer exist, still exported
+    std::vector<Gauge*> gauges;
+    std::vector<GaugeSnapshot> retired_gauges;  // Final values of gauges that no longer exist, still exported
+
+    template <typename T>
+    static void erase(std::vector<T*>& items, T* item) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (items[i] == item) {
+                items.erase(items.begin() + i);
+                return;
+            }
+        }
+    }
+};
+
+// Acquisition, contention, wait-time and hold-time statistics for one lock, condition variable or semaphore
+class LockStats {
+public:
+    LockStats(const std::string& name, const std::string& kind) : name(name), kind(kind) {
+        Registry::instance().add(this);
+    }
+    ~LockStats() { Registry::instance().remove(this); }
+    LockStats(const LockStats&) = delete;
+    LockStats& operator=(const LockStats&) = delete;
+
+    // An acquisition that waited wait_ns; contended means it could not be taken immediately
+    void record_acquire(uint64_t wait_ns, bool contended) {
+        LockShard& shard = shards[shard_index()];
+        shard.acquisitions.fetch_add(1, std::memory_order_relaxed);
+        if (contended) shard.contended.fetch_add(1, std::memory_order_relaxed);
+        shard.wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+        shard.wait_buckets[bucket_for(wait_ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A release after holding the lock for hold_ns
+    void record_hold(uint64_t hold_ns) {
+        LockShard& shard = shards[shard_index()];
+        shard.holds.fetch_add(1, std::memory_order_relaxed);
+        shard.hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+        shard.hold_buckets[bucket_for(hold_ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const std::string name;
+    const std::string kind;  // "mutex", "condvar" or "semaphore"
+
+    // Totals over all shards
+    LockSnapshot snapshot() const {
+        LockSnapshot s;
+        s.name = name;
+        s.kind = kind;
+        for (const LockShard& shard : shards) {
+            s.acquisitions += shard.acquisitions.load(std::memory_order_relaxed);
+            s.contended += shard.contended.load(std::memory_order_relaxed);
+            s.wait_ns += shard.wait_ns.load(std::memory_order_relaxed);
+            s.hold_ns += shard.hold_ns.load(std::memory_order_relaxed);
+            s.holds += shard.holds.load(std::memory_order_relaxed);
+            for (int b = 0; b < BUCKETS; ++b) {
+                s.wait_buckets[b] += shard.wait_buckets[b].load(std::memory_order_relaxed);
+                s.hold_buckets[b] += shard.hold_buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+        return s;
+    }
+
+private:
+    LockShard shards[SHARDS];
+};
+
+// A value that goes up and down, such as the number of items in a buffer, and the highest value seen
+class Gauge {
+public:
+    explicit Gauge(const std::string& name) : name(name), value(0), max(0) { Registry::instance().add(this); }
+    ~Gauge() { Registry::instance().remove(this); }
+    Gauge(const Gauge&) = delete;
+    Gauge& operator=(const Gauge&) = delete;
+
+    void set(int64_t v) {
+        value.store(v, std::memory_order_relaxed);
+        int64_t seen = max.load(std::memory_order_relaxed);
+        while (v > seen && !max.compare_exchange_weak(seen, v, std::memory_order_relaxed)) {}
+    }
+    int64_t get() const { return value.load(std::memory_order_relaxed); }
+    int64_t get_max() const { return max.load(std::memory_order_relaxed); }
+
+    const std::string name;
+
+private:
+    std::atomic<int64_t> value;
+    std::atomic<int64_t> max;
+};
+
+// Time a blocking acquisition: try first, and only time the slow path when that fails
+template <typename TryFn, typename BlockFn>
+inline void timed_acquire(LockStats& stats, TryFn try_acquire, BlockFn block) {
+    if (try_acquire()) {
+        stats.record_acquire(0, false);
+        return;
+    }
+    uint64_t start = now_ns();
+    block();
+    stats.record_acquire(now_ns() - start, true);
+}
+
+// Instrumented replacement for std::mutex; works with std::lock_guard and std::unique_lock
+class Mutex {
+public:
+    explicit Mutex(const std::string& name) : stats(name, "mutex"), hold_start(0) {}
+
+    void lock() {
+        timed_acquire(stats, [this] { return m.try_lock(); }, [this] { m.lock(); });
+        hold_start = now_ns();  // Only the owner touches hold_start
+    }
+
+    bool try_lock() {
+        if (!m.try_lock()) return false;
+        stats.record_acquire(0, false);
+        hold_start = now_ns();
+        return true;
+    }
+
+    void unlock() {
+        stats.record_hold(now_ns() - hold_start);
+        m.unlock();
+    }
+
+private:
+    std::mutex m;
+    LockStats stats;
+    uint64_t hold_start;
+};
+
+// Instrumented condition variable for use with sync_metrics::Mutex; records how long each wait blocked
+class CondVar {
+public:
+    explicit CondVar(const std::string& name) : stats(name, "condvar") {}
+
+    template <typename Lock>
+    void wait(Lock& lock) {
+        uint64_t start = now_ns();
+        cv.wait(lock);
+        stats.record_acquire(now_ns() - start, true);
+    }
+
+    template <typename Lock, typename Predicate>
+    void wait(Lock& lock, Predicate ready) {
+        while (!ready()) {
+            wait(lock);
+        }
+    }
+
+    void notify_one() { cv.notify_one(); }
+    void notify_all() { cv.notify_all(); }
+
+private:
+    std::condition_variable_any cv;
+    LockStats stats;
+};
+
+// Time sem_wait() on any semaphore, including one in shared memory
+inline void timed_sem_wait(sem_t* sem, LockStats& stats) {
+    timed_acquire(stats, [sem] { return sem_trywait(sem) == 0; },
+                  [sem] { while (sem_wait(sem) == -1) {} });  // Retry if interrupted by a signal
+}
+
+// Instrumented counting semaphore; a wait that finds the count at zero is counted as contended
+class Semaphore {
+public:
+    Semaphore(const std::string& name, unsigned int initial) : stats(name, "semaphore") {
+        sem_init(&sem, 0, initial);
+    }
+    ~Semaphore() { sem_destroy(&sem); }
+
+    void wait() { timed_sem_wait(&sem, stats); }
+    void post() { sem_post(&sem); }
+
+private:
+    sem_t sem;
+    LockStats stats;
+};
+
+inline void write_histogram(std::ostream& out, const std::string& metric, const std::string& labels,
+                            const uint64_t* buckets, uint64_t sum_ns, uint64_t count) {
+    uint64_t cumulative = 0;
+    for (int b = 0; b < BUCKETS - 1; ++b) {
+        cumulative += buckets[b];
+        out << metric << "_bucket{" << labels << ",le=\"" << (double)(1ULL << b) / 1e9 << "\"} " << cumulative << "\n";
+    }
+    out << metric << "_bucket{" << labels << ",le=\"+Inf\"} " << count << "\n";
+    out << metric << "_sum{" << labels << "} " << sum_ns / 1e9 << "\n";
+    out << metric << "_count{" << labels << "} " << count << "\n";
+}
+
+inline void Registry::remove(LockStats* stats) {
+    LockSnapshot last = stats->snapshot();
+    std::lock_guard<std::mutex> lock(mtx);
+    erase(locks, stats);
+    retired.push_back(last);
+}
+
+inline void Registry::remove(Gauge* gauge) {
+    GaugeSnapshot last;
+    last.name = gauge->name;
+    last.value = gauge->get();
+    last.max = gauge->get_max();
+    std::lock_guard<std::mutex> lock(mtx);
+    erase(gauges, gauge);
+    retired_gauges.push_back(last);
+}
+
+inline void Registry::write_prometheus(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<LockSnapshot> snaps(retired);
+    for (LockStats* stats : locks) {
+        snaps.push_back(stats->snapshot());
+    }
+    std::vector<GaugeSnapshot> gauge_snaps(retired_gauges);
+    for (Gauge* gauge : gauges) {
+        GaugeSnapshot snap;
+        snap.name = gauge->name;
+        snap.value = gauge->get();
+        snap.max = gauge->get_max();
+        gauge_snaps.push_back(snap);
+    }
+    auto labels = [&](size_t i) { return "lock=\"" + snaps[i].name + "\",kind=\"" + snaps[i].kind + "\""; };
+
+    out << "# TYPE sync_lock_acquisitions_total counter\n";
+    for (size_t i = 0; i < snaps.size(); ++i) {
+        out << "sync_lock_acquisitions_total{" << labels(i) << "} " << snaps[i].acquisitions << "\n";
+    }
+    out << "# TYPE sync_lock_contended_total counter\n";
+    for (size_t i = 0; i < snaps.size(); ++i) {
+        out << "sync_lock_contended_total{" << labels(i) << "} " << snaps[i].contended << "\n";
+    }
+    out << "# TYPE sync_lock_wait_seconds histogram\n";
+    for (size_t i = 0; i < snaps.size(); ++i) {
+        write_histogram(out, "sync_lock_wait_seconds", labels(i), snaps[i].wait_buckets, snaps[i].wait_ns, snaps[i].acquisitions);
+    }
+    out << "# TYPE sync_lock_hold_seconds histogram\n";
+    for (size_t i = 0; i < snaps.size(); ++i) {
+        if (snaps[i].holds == 0) continue;  // Condition variables and semaphores are not held
+        write_histogram(out, "sync_lock_hold_seconds", labels(i), snaps[i].hold_buckets, snaps[i].hold_ns, snaps[i].holds);
+    }
+    out << "# TYPE sync_gauge gauge\n";
+    for (const GaugeSnapshot& gauge : gauge_snaps) {
+        out << "sync_gauge{name=\"" << gauge.name << "\"} " << gauge.value << "\n";
+    }
+    out << "# TYPE sync_gauge_max gauge\n";
+    for (const GaugeSnapshot& gauge : gauge_snaps) {
+        out << "sync_gauge_max{name=\"" << gauge.name << "\"} " << gauge.max << "\n";
+    }
+}
+
+// Periodically writes all metrics to a file; the file is replaced atomically so a scraper never sees half of it
+class Exporter {
+public:
+    Exporter(const std::string& path, int interval_ms) : path(path), interval_ms(interval_ms), stopping(false) {
+        worker = std::thread([this] {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (!cv.wait_for(lock, std::chrono::milliseconds(this->interval_ms), [this] { return stopping; })) {
+                write();
+            }
+        });
+    }
+
+    ~Exporter() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        worker.join();
+        write();  // Final snapshot at exit
+    }
+
+    void write() {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ofstream::trunc);
+            Registry::instance().write_prometheus(out);
+        }
+        std::rename(tmp.c_str(), path.c_str());
+    }
+
+private:
+    std::string path;
+    int interval_ms;
+    bool stopping;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread worker;
+};
+
+// Start exporting if SYNC_METRICS_FILE is set; call once at the start of main
+inline void start_exporter() {
+    const char* path = std::getenv("SYNC_METRICS_FILE");
+    if (path == nullptr || *path == '\0') return;
+    const char* interval = std::getenv("SYNC_METRICS_INTERVAL_MS");
+    int interval_ms = interval ? std::atoi(interval) : 1000;
+    static Exporter exporter(path, interval_ms > 0 ? interval_ms : 1000);  // Destroyed at exit, after one last write
+}
+
+}  // namespace sync_metrics
+
+#endif
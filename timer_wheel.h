@@ -0,0 +1,323 @@
+/*
+Description:
+A timer service for periodic and one-shot work. Timers are kept in a hierarchical timing wheel
+(four levels of 64 slots, plus an overflow list for anything further out), so scheduling, cancelling
+and rescheduling a timer are O(1) no matter how many timers exist. One tick thread advances the wheel
+from a timerfd and hands every timer that expires on a tick to a small pool of worker threads as a batch.
+A program with 100,000 periodic jobs therefore needs a handful of threads instead of one sleeping thread per job.
+A periodic timer's callback never runs on two workers at once: a firing that comes due while the previous one is
+still running is skipped. Cancelling a timer also drops a firing that is still waiting for a worker.
+*/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/timerfd.h>  // For timerfd_create(), timerfd_settime()
+#include <unistd.h>       // For read(), close()
+
+class TimerWheel {
+public:
+    typedef std::function<void()> Callback;
+    typedef uint64_t TimerId;  // Slot index in the low 32 bits, generation in the high 32 bits
+
+    // Start the tick thread and num_workers worker threads; the wheel advances once every tick
+    explicit TimerWheel(int num_workers = 2, std::chrono::milliseconds tick = std::chrono::milliseconds(1))
+        : tick_ns(std::chrono::duration_cast<std::chrono::nanoseconds>(tick).count()), now_tick(0), draining(false), stopping(false) {
+        for (int level = 0; level < LEVELS; ++level) {
+            for (int slot = 0; slot < SLOTS; ++slot) {
+                wheel[level][slot] = NONE;
+            }
+        }
+        overflow = NONE;
+        free_list = NONE;
+
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        itimerspec spec = {};
+        spec.it_interval.tv_sec = tick_ns / 1000000000;
+        spec.it_interval.tv_nsec = tick_ns % 1000000000;
+        spec.it_value = spec.it_interval;
+        timerfd_settime(timer_fd, 0, &spec, NULL);
+
+        ticker = std::thread(&TimerWheel::tick_loop, this);
+        for (int i = 0; i < num_workers; ++i) {
+            workers.push_back(std::thread(&TimerWheel::worker_loop, this));
+        }
+    }
+
+    ~TimerWheel() {
+        stop();
+    }
+
+    // Run callback once after delay, then every period if period is non-zero
+    TimerId schedule(std::chrono::nanoseconds delay, std::chrono::nanoseconds period, Callback callback) {
+        std::lock_guard<std::mutex> lock(mtx);
+        int index = allocate_node();
+        Node& node = nodes[index];
+        node.callback = std::make_shared<Callback>(std::move(callback));
+        node.period = to_ticks(period);
+        node.expiry = now_tick + std::max<uint64_t>(1, to_ticks(delay)); // The current slot has already fired
+        node.active = true;
+        link(index);
+        return ((TimerId)node.generation << 32) | (uint32_t)index;
+    }
+
+    // Stop a timer from firing again; returns false if it already finished or was cancelled.
+    // A firing still queued for a worker is skipped; a callback that a worker has already started
+    // is allowed to finish.
+    bool cancel(TimerId id) {
+        std::lock_guard<std::mutex> lock(mtx);
+        int index = lookup(id);
+        if (index == NONE) return false;
+        Node& node = nodes[index];
+        if (node.head) unlink(index);
+        node.active = false;
+        if (!node.dispatched) release_node(index);  // Otherwise the worker releases it
+        return true;
+    }
+
+    // Move a pending timer so it next fires after delay and then every period (0 for one-shot)
+    bool reschedule(TimerId id, std::chrono::nanoseconds delay, std::chrono::nanoseconds period) {
+        std::lock_guard<std::mutex> lock(mtx);
+        int index = lookup(id);
+        if (index == NONE) return false;
+        if (nodes[index].head) unlink(index);
+        nodes[index].period = to_ticks(period);
+        nodes[index].expiry = now_tick + std::max<uint64_t>(1, to_ticks(delay));
+        link(index);
+        return true;
+    }
+
+    // Stop the tick and worker threads; batches already handed to the workers still run
+    void stop() {
+        if (stopping.exchange(true)) return;
+        ticker.join();
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            draining = true;  // No more batches will arrive
+            queue_cv.notify_all();
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        close(timer_fd);
+    }
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const int NONE = -1;
+
+    // A timer; it sits in exactly one doubly linked slot list while pending. A node stays allocated
+    // while a firing is dispatched, so a worker can tell whether it was cancelled in the meantime.
+    struct Node {
+        int prev = NONE;
+        int next = NONE;
+        int* head = nullptr;      // List the node is linked into
+        uint64_t expiry = 0;      // Tick on which the timer fires
+        uint64_t period = 0;      // Ticks between firings, 0 for one-shot timers
+        uint32_t generation = 0;  // Bumped on release so stale TimerIds are rejected
+        bool active = false;      // Pending or dispatched, and not cancelled
+        bool dispatched = false;  // A firing is queued or running; periodic firings are skipped until it ends
+        std::shared_ptr<Callback> callback;
+    };
+
+    typedef std::vector<int> Batch;  // Indexes of nodes whose firing was handed to the workers
+
+    int64_t tick_ns;
+    uint64_t now_tick;          // Number of ticks processed so far
+    int wheel[LEVELS][SLOTS];   // Head of each slot list
+    int overflow;               // Timers too far out for the top level
+    std::vector<Node> nodes;
+    int free_list;              // Released nodes, chained through next
+    std::mutex mtx;             // Protects everything above
+
+    std::deque<Batch> batches;  // Expired callbacks waiting for a worker
+    std::mutex queue_mtx;
+    std::condition_variable queue_cv;
+    bool draining;              // Set once the tick thread has stopped; workers exit when the queue is empty
+
+    int timer_fd;
+    std::atomic<bool> stopping;
+    std::thread ticker;
+    std::vector<std::thread> workers;
+
+    uint64_t to_ticks(std::chrono::nanoseconds duration) const {
+        return (duration.count() + tick_ns - 1) / tick_ns;  // Round up so timers never fire early
+    }
+
+    int allocate_node() {
+        if (free_list == NONE) {
+            nodes.emplace_back();
+            return nodes.size() - 1;
+        }
+        int index = free_list;
+        free_list = nodes[index].next;
+        nodes[index].next = NONE;
+        return index;
+    }
+
+    void release_node(int index) {
+        Node& node = nodes[index];
+        node.active = false;
+        node.dispatched = false;
+        node.generation++;
+        node.callback.reset();
+        node.next = free_list;
+        free_list = index;
+    }
+
+    int lookup(TimerId id) const {
+        uint32_t index = (uint32_t)id;
+        if (index >= nodes.size()) return NONE;
+        const Node& node = nodes[index];
+        if (!node.active || node.generation != (uint32_t)(id >> 32)) return NONE;
+        return index;
+    }
+
+    // Put a node into the slot that covers its expiry, relative to the current tick
+    void link(int index) {
+        Node& node = nodes[index];
+        uint64_t delta = node.expiry > now_tick ? node.expiry - now_tick : 0;
+        int* head = &overflow;
+        for (int level = 0; level < LEVELS; ++level) {
+            if (delta < (1ULL << (SLOT_BITS * (level + 1)))) {
+                head = &wheel[level][(node.expiry >> (SLOT_BITS * level)) & (SLOTS - 1)];
+                break;
+            }
+        }
+        node.head = head;
+        node.prev = NONE;
+        node.next = *head;
+        if (*head != NONE) nodes[*head].prev = index;
+        *head = index;
+    }
+
+    void unlink(int index) {
+        Node& node = nodes[index];
+        if (node.prev != NONE) nodes[node.prev].next = node.next;
+        else *node.head = node.next;
+        if (node.next != NONE) nodes[node.next].prev = node.prev;
+        node.prev = node.next = NONE;
+        node.head = nullptr;
+    }
+
+    // Detach a whole slot list and link its nodes again at their new level
+    void redistribute(int* head) {
+        int index = *head;
+        *head = NONE;
+        while (index != NONE) {
+            int next = nodes[index].next;
+            link(index);
+            index = next;
+        }
+    }
+
+    // Advance the wheel by one tick and collect the callbacks that expire on it
+    void advance(Batch& expired) {
+        now_tick++;
+
+        // When a level wraps around, the next slot of the level above is spread over the levels below
+        for (int level = 1; level <= LEVELS; ++level) {
+            if (now_tick & ((1ULL << (SLOT_BITS * level)) - 1)) break;
+            if (level == LEVELS) redistribute(&overflow);
+            else redistribute(&wheel[level][(now_tick >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+        }
+
+        int* head = &wheel[0][now_tick & (SLOTS - 1)];
+        int index = *head;
+        *head = NONE;
+        while (index != NONE) {
+            Node& node = nodes[index];
+            int next = node.next;
+            node.prev = node.next = NONE;
+            node.head = nullptr;
+            if (!node.dispatched) {
+                node.dispatched = true;
+                expired.push_back(index);
+            }  // Otherwise the previous firing is still running: skip this one rather than overlap it
+            if (node.period) {
+                node.expiry += node.period;  // Periodic timers keep their phase even if a callback runs late
+                link(index);
+            }  // One-shot nodes are released by the worker once their firing is done or skipped
+            index = next;
+        }
+    }
+
+    // Tick thread: wait for the timerfd, advance the wheel and hand expired timers to the workers
+    void tick_loop() {
+        while (!stopping.load()) {
+            uint64_t ticks = 0;
+            if (read(timer_fd, &ticks, sizeof(ticks)) != sizeof(ticks)) continue;
+
+            Batch expired;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                for (uint64_t i = 0; i < ticks; ++i) {
+                    advance(expired);  // Catch up on ticks missed while this thread was delayed
+                }
+            }
+            if (expired.empty()) continue;
+
+            // Split the batch evenly between the workers
+            size_t parts = std::min(expired.size(), workers.size());
+            size_t per_part = (expired.size() + parts - 1) / parts;
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            for (size_t start = 0; start < expired.size(); start += per_part) {
+                size_t end = std::min(expired.size(), start + per_part);
+                batches.push_back(Batch(expired.begin() + start, expired.begin() + end));
+            }
+            if (parts == 1) queue_cv.notify_one();
+            else queue_cv.notify_all();
+        }
+    }
+
+    // Run one dispatched firing unless the timer was cancelled after it was handed out
+    void run_firing(int index) {
+        std::shared_ptr<Callback> callback;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!nodes[index].active) {
+                release_node(index);  // Cancelled while queued
+                return;
+            }
+            callback = nodes[index].callback;
+        }
+        (*callback)();
+        std::lock_guard<std::mutex> lock(mtx);
+        Node& node = nodes[index];
+        node.dispatched = false;
+        // Release cancelled timers and one-shot timers that were not rescheduled while running
+        if (!node.active || (node.period == 0 && node.head == nullptr)) release_node(index);
+    }
+
+    // Worker thread: run batches of expired callbacks
+    void worker_loop() {
+        while (true) {
+            Batch batch;
+            {
+                std::unique_lock<std::mutex> lock(queue_mtx);
+                queue_cv.wait(lock, [this] { return !batches.empty() || draining; });
+                if (batches.empty()) return;
+                batch = std::move(batches.front());
+                batches.pop_front();
+            }
+            for (int index : batch) {
+                run_firing(index);
+            }
+        }
+    }
+};
+
+#endif